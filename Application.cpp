@@ -5,6 +5,7 @@
  **********************************/
 
 #include "Application.h"
+#include <dirent.h>
 
 void handler(int sig) {
 	void *array[10];
@@ -47,11 +48,23 @@ int main(int argc, char *argv[]) {
 Application::Application(char *infile) {
 	int i;
 	par = new Params();
-	srand (time(NULL));
 	par->setparams(infile);
+	rng = par->rng(0, RNG_APP);
+	Message::textFormat = par->TEXT_MSG;
+	if ( !par->RECOVER ) {
+		clearDataDir();
+	}
 	log = new Log(par);
-	en = new EmulNet(par);
-	en1 = new EmulNet(par);
+	en = new EmulNet(par, RNG_NET_MP1);
+	en1 = new EmulNet(par, RNG_NET_MP2);
+	pool = new ThreadPool(par->THREADS);
+	en->ENworkers(pool->size());
+	en1->ENworkers(pool->size());
+	log->workers(pool->size());
+	MsgPool::workers(pool->size());
+	if ( par->LSM && par->COMPACT_RUNS > 0 ) {
+		Compactor::start(par->COMPACT_THREADS > 0 ? par->COMPACT_THREADS : par->THREADS, par->COMPACT_RATE);
+	}
 	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
 	mp2 = (MP2Node **) malloc(par->EN_GPSZ * sizeof(MP2Node *));
 
@@ -73,10 +86,33 @@ Application::Application(char *infile) {
 	}
 }
 
+/**
+ * FUNCTION NAME: clearDataDir
+ *
+ * DESCRIPTION: Removes the node files a previous run left in DATA_DIR: write-ahead
+ * 				logs, table files and hint spills. Every run starts from empty stores
+ * 				unless RECOVER is set.
+ */
+void Application::clearDataDir() {
+	DIR *dir = opendir(par->DATA_DIR);
+	struct dirent *e;
+
+	if ( !dir ) {
+		return;
+	}
+	while ( (e = readdir(dir)) != NULL ) {
+		if ( 0 == strncmp(e->d_name, "node", 4) ) {
+			unlink((string(par->DATA_DIR) + "/" + e->d_name).c_str());
+		}
+	}
+	closedir(dir);
+}
+
 /**
  * Destructor
  */
 Application::~Application() {
+	delete pool;
 	delete log;
 	delete en;
 	delete en1;
@@ -86,7 +122,10 @@ Application::~Application() {
 	}
 	free(mp1);
 	free(mp2);
+	// the stores cancelled their merges
+	Compactor::stop();
 	delete par;
+	MsgPool::drain();
 }
 
 /**
@@ -100,10 +139,12 @@ int Application::run()
 	int timeWhenAllNodesHaveJoined = 0;
 	// boolean indicating if all nodes have joined
 	bool allNodesJoined = false;
-	srand(time(NULL));
 
 	// As time runs along
 	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
+		// Open the message buffer arena of this time unit
+		MsgPool::tick(par->globaltime);
+
 		// Run the membership protocol
 		mp1Run();
 
@@ -120,9 +161,14 @@ int Application::run()
 		//fail();
 	}
 
+	reportLatency();
+
 	// Clean up
 	en->ENcleanup();
 	en1->ENcleanup();
+	reportReadTraffic();
+	// these depend on THREADS, msgcount.log does not
+	MsgPool::printAllocatorStats(stdout);
 
 	for(i=0;i<=par->EN_GPSZ-1;i++) {
 		 mp1[i]->finishUpThisNode();
@@ -134,10 +180,13 @@ int Application::run()
 /**
  * FUNCTION NAME: mp1Run
  *
- * DESCRIPTION:	This function performs all the membership protocol functionalities
+ * DESCRIPTION:	This function performs all the membership protocol functionalities.
+ * 				Each phase runs its nodes on the thread pool; sends and log lines
+ * 				are merged in node order at the end of the phase.
  */
 void Application::mp1Run() {
 	int i;
+	vector<int> order;
 
 	// For all the nodes in the system
 	for( i = 0; i <= par->EN_GPSZ-1; i++) {
@@ -146,14 +195,23 @@ void Application::mp1Run() {
 		 * Receive messages from the network and queue them in the membership protocol queue
 		 */
 		if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
-			// Receive messages from the network and queue them
-			mp1[i]->recvLoop();
+			order.push_back(i);
 		}
 
 	}
+	pool->parallelFor(order, [this](int i) {
+		// Receive messages from the network and queue them
+		mp1[i]->recvLoop();
+	});
 
 	// For all the nodes in the system
+	order.clear();
 	for( i = par->EN_GPSZ - 1; i >= 0; i-- ) {
+		if( par->getcurrtime() == (int)(par->STEP_RATE*i) || (par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed)) ) {
+			order.push_back(i);
+		}
+	}
+	pool->parallelFor(order, [this](int i) {
 
 		/*
 		 * Introduce nodes into the distributed system
@@ -161,14 +219,12 @@ void Application::mp1Run() {
 		if( par->getcurrtime() == (int)(par->STEP_RATE*i) ) {
 			// introduce the ith node into the system at time STEPRATE*i
 			mp1[i]->nodeStart(JOINADDR, par->PORTNUM);
-			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i]->getMemberNode()->addr.getAddress() << endl;
-			nodeCount += i;
 		}
 
 		/*
 		 * Handle all the messages in your queue and send heartbeats
 		 */
-		else if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
+		else {
 			// handle messages and send heartbeats
 			mp1[i]->nodeLoop();
 			#ifdef DEBUGLOG
@@ -178,6 +234,15 @@ void Application::mp1Run() {
 			#endif
 		}
 
+	});
+	en->ENflush();
+	log->flush();
+
+	for( i = par->EN_GPSZ - 1; i >= 0; i-- ) {
+		if( par->getcurrtime() == (int)(par->STEP_RATE*i) ) {
+			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i]->getMemberNode()->addr.getAddress() << endl;
+			nodeCount += i;
+		}
 	}
 }
 
@@ -191,32 +256,39 @@ void Application::mp1Run() {
  */
 void Application::mp2Run() {
 	int i;
+	vector<int> order;
 
 	// For all the nodes in the system
 	for( i = 0; i <= par->EN_GPSZ-1; i++) {
-
-		/*
-		 * 1) Update the ring
-		 * 2) Receive messages from the network and queue them in the KV store queue
-		 */
 		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
-			if ( mp2[i]->getMemberNode()->inited && mp2[i]->getMemberNode()->inGroup ) {
-				// Step 1
-				mp2[i]->updateRing();
-			}
-			// Step 2
-			mp2[i]->recvLoop();
+			order.push_back(i);
 		}
 	}
 
+	/*
+	 * 1) Update the ring
+	 * 2) Receive messages from the network and queue them in the KV store queue
+	 */
+	pool->parallelFor(order, [this](int i) {
+		if ( mp2[i]->getMemberNode()->inited && mp2[i]->getMemberNode()->inGroup ) {
+			// Step 1
+			mp2[i]->updateRing();
+		}
+		// Step 2
+		mp2[i]->recvLoop();
+	});
+	en1->ENflush();
+	log->flush();
+
 	/**
 	 * Handle messages from the queue and update the DHT
 	 */
-	for ( i = par->EN_GPSZ-1; i >= 0; i-- ) {
-		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
-			mp2[i]->checkMessages();
-		}
-	}
+	reverse(order.begin(), order.end());
+	pool->parallelFor(order, [this](int i) {
+		mp2[i]->checkMessages();
+	});
+	en1->ENflush();
+	log->flush();
 
 	/**
 	 * Insert a set of test key value pairs into the system
@@ -225,6 +297,13 @@ void Application::mp2Run() {
 		insertTestKVPairs();
 	}
 
+	/**
+	 * Report how evenly the test keys are spread over the ring
+	 */
+	if ( par->getcurrtime() == TEST_TIME ) {
+		reportOwnership();
+	}
+
 	/**
 	 * Test CRUD operations
 	 */
@@ -342,14 +421,14 @@ void Application::fail() {
 	}
 
 	if( par->SINGLE_FAILURE && par->getcurrtime() == 100 ) {
-		removed = (rand() % par->EN_GPSZ);
+		removed = rng.below(par->EN_GPSZ);
 		#ifdef DEBUGLOG
 		log->LOG(&mp1[removed]->getMemberNode()->addr, "Node failed at time=%d", par->getcurrtime());
 		#endif
 		mp1[removed]->getMemberNode()->bFailed = true;
 	}
 	else if( par->getcurrtime() == 100 ) {
-		removed = rand() % par->EN_GPSZ/2;
+		removed = rng.below(par->EN_GPSZ) / 2;
 		for ( i = removed; i < removed + par->EN_GPSZ/2; i++ ) {
 			#ifdef DEBUGLOG
 			log->LOG(&mp1[i]->getMemberNode()->addr, "Node failed at time = %d", par->getcurrtime());
@@ -387,7 +466,7 @@ Address Application::getjoinaddr(void){
 int Application::findARandomNodeThatIsAlive() {
 	int number;
 	do {
-		number = (rand()%par->EN_GPSZ);
+		number = rng.below(par->EN_GPSZ);
 	}while (mp2[number]->getMemberNode()->bFailed);
 	return number;
 }
@@ -398,7 +477,6 @@ int Application::findARandomNodeThatIsAlive() {
  * DESCRIPTION: Init NUMBER_OF_INSERTS test KV pairs in the map
  */
 void Application::initTestKVPairs() {
-	srand(time(NULL));
 	int i;
 	string key;
 	key.clear();
@@ -406,9 +484,9 @@ void Application::initTestKVPairs() {
 	int alphanumLen = sizeof(alphanum) - 1;
 	while ( testKVPairs.size() != NUMBER_OF_INSERTS ) {
 		for ( i = 0; i < KEY_LENGTH; i++ ) {
-			key.push_back(alphanum[rand()%alphanumLen]);
+			key.push_back(alphanum[rng.below(alphanumLen)]);
 		}
-		string value = "value" + to_string(rand()%NUMBER_OF_INSERTS);
+		string value = "value" + to_string(rng.below(NUMBER_OF_INSERTS));
 		testKVPairs[key] = value;
 		key.clear();
 	}
@@ -417,7 +495,8 @@ void Application::initTestKVPairs() {
 /**
  * FUNCTION NAME: insertTestKVPairs
  *
- * DESCRIPTION: This function inserts test KV pairs into the system
+ * DESCRIPTION: This function inserts test KV pairs into the system, in one batched
+ * 				request to a node that is alive
  */
 void Application::insertTestKVPairs() {
 	int number = 0;
@@ -427,18 +506,150 @@ void Application::insertTestKVPairs() {
 	 */
 	initTestKVPairs();
 
-	for ( map<string, string>::iterator it = testKVPairs.begin(); it != testKVPairs.end(); ++it ) {
-		// Step 1. Find a node that is alive
-		number = findARandomNodeThatIsAlive();
+	// Step 1. Find a node that is alive
+	number = findARandomNodeThatIsAlive();
 
-		// Step 2. Issue a create operation
+	// Step 2. Issue the create operations
+	for ( map<string, string>::iterator it = testKVPairs.begin(); it != testKVPairs.end(); ++it ) {
 		log->LOG(&mp2[number]->getMemberNode()->addr, "CREATE OPERATION KEY: %s VALUE: %s at time: %d", it->first.c_str(), it->second.c_str(), par->getcurrtime());
-		mp2[number]->clientCreate(it->first, it->second);
 	}
+	mp2[number]->multiPut(testKVPairs);
 
 	cout<<endl<<"Sent " <<testKVPairs.size() <<" create messages to the ring"<<endl;
 }
 
+/**
+ * FUNCTION NAME: reportOwnership
+ *
+ * DESCRIPTION: Writes to the stats log, for every alive node, its share of the ring,
+ * 				the number of test keys it is primary for, the number of keys it
+ * 				stores and the bytes its store takes per key, followed by the mean
+ * 				and variance of each figure across nodes
+ */
+void Application::reportOwnership() {
+	int i, n = 0;
+	unsigned long bytes, totalBytes = 0, totalKeys = 0;
+	int number = findARandomNodeThatIsAlive();
+	Ring &ring = mp2[number]->getRing();
+	vector<double> share, primary, stored;
+	double mean[3], var[3];
+	vector<double> *fig[3] = { &share, &primary, &stored };
+
+	for ( i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( mp2[i]->getMemberNode()->bFailed ) {
+			continue;
+		}
+		share.push_back(ring.share(mp2[i]->getMemberNode()->addr));
+		primary.push_back(0);
+		stored.push_back((double) mp2[i]->keyCount());
+		for ( map<string, string>::iterator it = testKVPairs.begin(); it != testKVPairs.end(); ++it ) {
+			vector<Node> replicas = mp2[number]->findNodes(it->first);
+			if ( !replicas.empty() && *replicas.at(0).getAddress() == mp2[i]->getMemberNode()->addr ) {
+				primary.back()++;
+			}
+		}
+		bytes = mp2[i]->storeBytes();
+		totalBytes += bytes;
+		totalKeys += mp2[i]->keyCount();
+		log->LOG(&mp2[i]->getMemberNode()->addr, "#STATSLOG# ring share %.4f primary keys %d stored keys %d store bytes %lu bytes per key %.1f",
+				share.back(), (int) primary.back(), (int) stored.back(), bytes, stored.back() > 0 ? bytes / stored.back() : 0.0);
+		mp2[i]->logStorageStats();
+		n++;
+	}
+	if ( n == 0 ) {
+		return;
+	}
+	for ( int f = 0; f < 3; f++ ) {
+		mean[f] = var[f] = 0;
+		for ( i = 0; i < n; i++ ) {
+			mean[f] += fig[f]->at(i);
+		}
+		mean[f] /= n;
+		for ( i = 0; i < n; i++ ) {
+			var[f] += (fig[f]->at(i) - mean[f]) * (fig[f]->at(i) - mean[f]);
+		}
+		var[f] /= n;
+	}
+	log->LOG(&mp2[number]->getMemberNode()->addr, "#STATSLOG# ownership nodes %d tokens %d share mean %.4f variance %.6f primary keys mean %.2f variance %.2f stored keys mean %.2f variance %.2f bytes per key %.1f",
+			n, ring.size(), mean[0], var[0], mean[1], var[1], mean[2], var[2], totalKeys > 0 ? (double) totalBytes / totalKeys : 0.0);
+}
+
+/**
+ * FUNCTION NAME: reportLatency
+ *
+ * DESCRIPTION: Writes to the stats log the median, 99th percentile and maximum time
+ * 				in time units the coordinators took to answer each type of client
+ * 				request, with the quorum sizes and the replies that came after
+ * 				their request was answered
+ */
+void Application::reportLatency() {
+	static const char *names[] = { "create", "read", "update", "delete" };
+	long lateReplies = 0;
+
+	for ( int t = CREATE; t <= DELETE; t++ ) {
+		vector<long> hist;
+		long count = 0, seen = 0;
+		int p50 = -1, p99 = -1;
+		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+			const vector<long> &h = mp2[i]->getLatency((MessageType) t);
+			if ( hist.size() < h.size() ) {
+				hist.resize(h.size(), 0);
+			}
+			for ( size_t d = 0; d < h.size(); d++ ) {
+				hist[d] += h[d];
+				count += h[d];
+			}
+		}
+		if ( count == 0 ) {
+			continue;
+		}
+		// nearest rank
+		for ( size_t d = 0; d < hist.size(); d++ ) {
+			seen += hist[d];
+			if ( p50 < 0 && seen * 100 >= count * 50 ) {
+				p50 = d;
+			}
+			if ( p99 < 0 && seen * 100 >= count * 99 ) {
+				p99 = d;
+			}
+		}
+		log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# latency %s requests %ld p50 %d p99 %d max %d",
+				names[t], count, p50, p99, (int) hist.size() - 1);
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		lateReplies += mp2[i]->getLateReplies();
+	}
+	log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# quorum read %d write %d late replies %ld",
+			par->READ_QUORUM, par->WRITE_QUORUM, lateReplies);
+}
+
+/**
+ * FUNCTION NAME: reportReadTraffic
+ *
+ * DESCRIPTION: Appends to msgcount.log the READ messages the coordinators sent, with
+ * 				the three per read of the broadcast mode they replace
+ */
+void Application::reportReadTraffic() {
+	long reads = 0, msgs = 0, hedges = 0, replies = 0, r, m, h, rp;
+	FILE *file = fopen("msgcount.log", "a");
+
+	if ( !file ) {
+		return;
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		mp2[i]->getReadTraffic(r, m, h, rp);
+		reads += r;
+		msgs += m;
+		hedges += h;
+		replies += rp;
+	}
+	fprintf(file, "read mode %s reads %ld read messages %ld broadcast %ld saved %ld (%.1f%%) hedges %ld replies %ld\n",
+			par->HEDGED_READS ? "hedged" : "broadcast", reads, msgs, reads * RING_REPLICAS,
+			reads * RING_REPLICAS - msgs, reads > 0 ? 100.0 * (reads * RING_REPLICAS - msgs) / (reads * RING_REPLICAS) : 0.0,
+			hedges, replies);
+	fclose(file);
+}
+
 /**
  * FUNCTION NAME: deleteTest
  *
@@ -17,6 +17,8 @@
 #include "MP2Node.h"
 #include "Node.h"
 #include "common.h"
+#include "ThreadPool.h"
+#include "Compactor.h"
 
 /**
  * global variables
@@ -57,17 +59,25 @@ private:
 	MP1Node **mp1;
 	MP2Node **mp2;
 	Params *par;
+	// tick engine, runs the nodes of each phase of a time unit
+	ThreadPool *pool;
+	// draws of the test driver: failed nodes, test keys
+	Random rng;
 	map<string, string> testKVPairs;
 public:
 	Application(char *);
 	virtual ~Application();
 	Address getjoinaddr();
+	void clearDataDir();
 	void initTestKVPairs();
 	int run();
 	void mp1Run();
 	void mp2Run();
 	void fail();
 	void insertTestKVPairs();
+	void reportOwnership();
+	void reportLatency();
+	void reportReadTraffic();
 	int findARandomNodeThatIsAlive();
 	void deleteTest();
 	void readTest();
@@ -0,0 +1,61 @@
+/**********************************
+ * FILE NAME: Batch.cpp
+ *
+ * DESCRIPTION: Definition of the records of the batched messages
+ **********************************/
+
+#include "Batch.h"
+
+/**
+ * FUNCTION NAME: append
+ *
+ * DESCRIPTION: Adds the record of op at the end of payload
+ */
+void Batch::append(string &payload, const batch_op &op) {
+	size_t at = payload.size();
+	unsigned int klen = (unsigned int) op.key.size();
+	unsigned int vlen = (unsigned int) op.value.size();
+
+	payload.resize(at + BATCH_RECSZ);
+	memcpy(&payload[at], &op.index, sizeof(int));
+	memcpy(&payload[at + 4], &op.transID, sizeof(int));
+	payload[at + 8] = (char) op.type;
+	payload[at + 9] = (char) op.replica;
+	payload[at + 10] = (char) op.success;
+	memcpy(&payload[at + 11], &op.timestamp, sizeof(int));
+	memcpy(&payload[at + 15], &klen, sizeof(klen));
+	memcpy(&payload[at + 19], &vlen, sizeof(vlen));
+	payload.append(op.key.data(), klen);
+	payload.append(op.value.data(), vlen);
+}
+
+/**
+ * FUNCTION NAME: next
+ *
+ * DESCRIPTION: Reads the first record of payload into op and drops it from payload
+ *
+ * RETURNS:
+ * false once payload is empty, or if its first record is cut short
+ */
+bool Batch::next(string_view &payload, batch_op *op) {
+	unsigned int klen, vlen;
+
+	if ( payload.size() < BATCH_RECSZ ) {
+		return false;
+	}
+	memcpy(&op->index, &payload[0], sizeof(int));
+	memcpy(&op->transID, &payload[4], sizeof(int));
+	op->type = static_cast<MessageType>(payload[8]);
+	op->replica = static_cast<ReplicaType>(payload[9]);
+	op->success = (payload[10] != 0);
+	memcpy(&op->timestamp, &payload[11], sizeof(int));
+	memcpy(&klen, &payload[15], sizeof(klen));
+	memcpy(&vlen, &payload[19], sizeof(vlen));
+	if ( (size_t) BATCH_RECSZ + klen + vlen > payload.size() ) {
+		return false;
+	}
+	op->key = payload.substr(BATCH_RECSZ, klen);
+	op->value = payload.substr(BATCH_RECSZ + klen, vlen);
+	payload.remove_prefix(BATCH_RECSZ + klen + vlen);
+	return true;
+}
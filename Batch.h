@@ -0,0 +1,53 @@
+/**********************************
+ * FILE NAME: Batch.h
+ *
+ * DESCRIPTION: Records of the batched multi-key messages
+ **********************************/
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "stdincludes.h"
+#include "common.h"
+
+/*
+ * Macros
+ */
+// record: index(4) transID(4) type(1) replica(1) success(1) timestamp(4) keylen(4) valuelen(4) key value
+#define BATCH_RECSZ 23
+
+/**
+ * STRUCT NAME: batch_op
+ *
+ * DESCRIPTION: One key of a batch. index is the position of the key in the request of
+ * 				the coordinator, the reply carries it back. Every key has its own
+ * 				transID, the one its operation is logged with. key and value point
+ * 				into the payload they were read from.
+ */
+typedef struct batch_op {
+	int index;
+	int transID;
+	MessageType type;
+	ReplicaType replica;
+	bool success;
+	int timestamp;
+	string_view key;
+	string_view value;
+} batch_op;
+
+/**
+ * CLASS NAME: Batch
+ *
+ * DESCRIPTION: The value of a BATCH or BATCHREPLY message: the records of several
+ * 				keys, one after the other. A request record holds the key and, for a
+ * 				write, the value; its reply holds the outcome and, for a read, the
+ * 				value found and its version.
+ */
+class Batch {
+public:
+	static size_t recordSize(const batch_op &op) { return BATCH_RECSZ + op.key.size() + op.value.size(); }
+	static void append(string &payload, const batch_op &op);
+	static bool next(string_view &payload, batch_op *op);
+};
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,82 @@
+/**********************************
+ * FILE NAME: BloomCheck.cpp
+ *
+ * DESCRIPTION: Checks that the probe mayContain uses, AVX2 when built with SIMD=1,
+ * 				answers as the portable probe on every hash
+ *
+ * RUN PROCEDURE:
+ * $ make clean; make bloomcheck SIMD=1
+ * $ ./bloomcheck [probes]
+ **********************************/
+
+#include "BloomFilter.h"
+#include "Random.h"
+
+/**
+ * FUNCTION NAME: check
+ *
+ * DESCRIPTION: Fills a filter of keys keys, then probes it with the added hashes and
+ * 				with probes random ones
+ *
+ * RETURNS:
+ * number of hashes the two probes disagree on, -1 if an added hash is missed
+ */
+static long check(size_t keys, int bitsPerKey, long probes, Random &rng, long *positives) {
+	BloomFilter filter(keys, bitsPerKey);
+	vector<uint64_t> added(keys);
+	long differ = 0;
+	uint64_t h;
+
+	for ( size_t i = 0; i < keys; i++ ) {
+		added[i] = rng();
+		filter.add(added[i]);
+	}
+	for ( size_t i = 0; i < keys; i++ ) {
+		if ( !filter.mayContain(added[i]) || !filter.mayContainScalar(added[i]) ) {
+			return -1;
+		}
+	}
+	*positives = 0;
+	for ( long i = 0; i < probes; i++ ) {
+		h = rng();
+		if ( filter.mayContain(h) != filter.mayContainScalar(h) ) {
+			differ++;
+		}
+		*positives += filter.mayContain(h);
+	}
+	return differ;
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: Runs the check on a few filter sizes, exits 1 on any difference
+ */
+int main(int argc, char *argv[]) {
+	static const size_t keys[] = { 1, 100, 10000, 100000 };
+	static const int bits[] = { 10, 4 };
+	long probes = (argc > 1) ? atol(argv[1]) : 1000000;
+	long differ, positives;
+	Random rng(42);
+
+#ifdef __AVX2__
+	printf("AVX2 probe against the portable probe, %ld probes a filter\n", probes);
+#else
+	printf("built without SIMD=1, both probes are the portable one\n");
+#endif
+	for ( int b = 0; b < 2; b++ ) {
+		for ( int k = 0; k < 4; k++ ) {
+			differ = check(keys[k], bits[b], probes, rng, &positives);
+			if ( differ < 0 ) {
+				printf("%6zu keys %2d bits per key: an added key is missed\n", keys[k], bits[b]);
+				return 1;
+			}
+			printf("%6zu keys %2d bits per key: %ld differences, %.4f false positives\n",
+					keys[k], bits[b], differ, (double) positives / probes);
+			if ( differ > 0 ) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+/**********************************
+ * FILE NAME: BloomFilter.cpp
+ *
+ * DESCRIPTION: Definition of the blocked Bloom filter
+ **********************************/
+
+#include "BloomFilter.h"
+
+// odd multipliers picking the bit of each word, same as the AVX2 probe
+static const uint32_t bloomSalt[BLOOM_WORDS] = { 0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+		0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31 };
+
+/**
+ * Constructor of an empty filter
+ */
+BloomFilter::BloomFilter(): words(NULL), nblocks(0), owned(true) {
+}
+
+/**
+ * Constructor of a filter sized for keys keys, about 1% false positives at 10 bits per key
+ */
+BloomFilter::BloomFilter(size_t keys, int bitsPerKey): words(NULL), nblocks(0), owned(true) {
+	if ( keys > 0 && bitsPerKey > 0 ) {
+		allocate((keys * bitsPerKey + BLOOM_BLOCK * 8 - 1) / (BLOOM_BLOCK * 8));
+	}
+}
+
+/**
+ * Destructor
+ */
+BloomFilter::~BloomFilter() {
+	if ( owned ) {
+		free(words);
+	}
+}
+
+/**
+ * FUNCTION NAME: allocate
+ *
+ * DESCRIPTION: Allocates zeroed, cache line aligned blocks
+ */
+void BloomFilter::allocate(size_t blocks) {
+	size_t size = (blocks * BLOOM_BLOCK + BLOOM_ALIGN - 1) / BLOOM_ALIGN * BLOOM_ALIGN;
+
+	if ( owned ) {
+		free(words);
+	}
+	owned = true;
+	words = (uint32_t *) aligned_alloc(BLOOM_ALIGN, size);
+	memset(words, 0, size);
+	nblocks = blocks;
+}
+
+/**
+ * FUNCTION NAME: hashOf
+ *
+ * DESCRIPTION: 64 bit hash of a key, FNV-1a followed by the murmur3 finalizer
+ */
+uint64_t BloomFilter::hashOf(string_view key) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for ( size_t i = 0; i < key.size(); i++ ) {
+		h = (h ^ (unsigned char) key[i]) * 0x100000001b3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * FUNCTION NAME: masks
+ *
+ * DESCRIPTION: Bit to set in each word of a block
+ */
+void BloomFilter::masks(uint32_t h, uint32_t m[BLOOM_WORDS]) {
+	for ( int i = 0; i < BLOOM_WORDS; i++ ) {
+		m[i] = 1u << ((h * bloomSalt[i]) >> 27);
+	}
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Adds the key of hash
+ */
+void BloomFilter::add(uint64_t hash) {
+	uint32_t m[BLOOM_WORDS];
+	uint32_t *b;
+
+	if ( nblocks == 0 ) {
+		return;
+	}
+	b = (uint32_t *) block(hash);
+	masks((uint32_t) hash, m);
+	for ( int i = 0; i < BLOOM_WORDS; i++ ) {
+		b[i] |= m[i];
+	}
+}
+
+/**
+ * FUNCTION NAME: load
+ *
+ * DESCRIPTION: Loads a filter written from data() and bytes()
+ *
+ * RETURNS:
+ * false if size is not a whole number of blocks
+ */
+bool BloomFilter::load(const char *data, size_t size) {
+	if ( size % BLOOM_BLOCK != 0 ) {
+		return false;
+	}
+	if ( size == 0 ) {
+		if ( owned ) {
+			free(words);
+		}
+		words = NULL;
+		nblocks = 0;
+		owned = true;
+		return true;
+	}
+	allocate(size / BLOOM_BLOCK);
+	memcpy(words, data, size);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: attach
+ *
+ * DESCRIPTION: Uses a filter written from data() and bytes() where it lies, typically
+ * 				in a read-only mapping that outlives the filter. Nothing may be added.
+ *
+ * RETURNS:
+ * false if data is not cache line aligned or size not a whole number of blocks
+ */
+bool BloomFilter::attach(const char *data, size_t size) {
+	if ( size == 0 || size % BLOOM_BLOCK != 0 || (uintptr_t) data % BLOOM_ALIGN != 0 ) {
+		return false;
+	}
+	if ( owned ) {
+		free(words);
+	}
+	words = (uint32_t *) data;
+	nblocks = size / BLOOM_BLOCK;
+	owned = false;
+	return true;
+}
@@ -0,0 +1,103 @@
+/**********************************
+ * FILE NAME: BloomFilter.h
+ *
+ * DESCRIPTION: Blocked Bloom filter of the table files
+ **********************************/
+
+#ifndef BLOOMFILTER_H_
+#define BLOOMFILTER_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+#include <string_view>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * Macros
+ */
+// one block: eight 32 bit words, two blocks per cache line
+#define BLOOM_WORDS 8
+#define BLOOM_BLOCK (BLOOM_WORDS * 4)
+#define BLOOM_ALIGN 64
+
+/**
+ * CLASS NAME: BloomFilter
+ *
+ * DESCRIPTION: Split block Bloom filter. A key selects one 32 byte block with the
+ * 				high half of its hash and sets one bit in each of the eight words of
+ * 				the block with the low half, so a probe touches a single cache line.
+ * 				Built with AVX2 (make SIMD=1) the eight words are probed with one
+ * 				vector compare.
+ *
+ * 				The hash is computed here rather than with std::hash because
+ * 				filters are stored on disk.
+ */
+class BloomFilter {
+private:
+	uint32_t *words;
+	size_t nblocks;
+	// words belong to the filter, not to a mapped file
+	bool owned;
+	static void masks(uint32_t h, uint32_t m[BLOOM_WORDS]);
+	void allocate(size_t blocks);
+	const uint32_t *block(uint64_t hash) { return words + ((((hash >> 32) * nblocks) >> 32) * BLOOM_WORDS); }
+public:
+	BloomFilter();
+	BloomFilter(size_t keys, int bitsPerKey);
+	BloomFilter(const BloomFilter &) = delete;
+	BloomFilter &operator=(const BloomFilter &) = delete;
+	virtual ~BloomFilter();
+	static uint64_t hashOf(string_view key);
+	bool empty() { return nblocks == 0; }
+	void add(uint64_t hash);
+	bool load(const char *data, size_t size);
+	bool attach(const char *data, size_t size);
+	size_t heapBytes() { return owned ? bytes() : 0; }
+	const char *data() { return (const char *) words; }
+	size_t bytes() { return nblocks * BLOOM_BLOCK; }
+
+	/**
+	 * FUNCTION NAME: mayContain
+	 *
+	 * DESCRIPTION: Returns false if the key of hash was never added. An empty filter
+	 * 				may contain anything.
+	 */
+	bool mayContain(uint64_t hash) {
+#ifdef __AVX2__
+		if ( nblocks == 0 ) {
+			return true;
+		}
+		const __m256i salt = _mm256_setr_epi32(0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+				0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31);
+		__m256i m = _mm256_mullo_epi32(_mm256_set1_epi32((uint32_t) hash), salt);
+		m = _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_srli_epi32(m, 27));
+		return _mm256_testc_si256(_mm256_load_si256((const __m256i *) block(hash)), m);
+#else
+		return mayContainScalar(hash);
+#endif
+	}
+
+	/**
+	 * FUNCTION NAME: mayContainScalar
+	 *
+	 * DESCRIPTION: Portable probe, the one mayContain uses without AVX2
+	 */
+	bool mayContainScalar(uint64_t hash) {
+		if ( nblocks == 0 ) {
+			return true;
+		}
+		const uint32_t *b = block(hash);
+		uint32_t m[BLOOM_WORDS];
+		bool hit = true;
+		masks((uint32_t) hash, m);
+		// no early exit, the compiler turns this into straight line code
+		for ( int i = 0; i < BLOOM_WORDS; i++ ) {
+			hit &= (b[i] & m[i]) != 0;
+		}
+		return hit;
+	}
+};
+
+#endif /* BLOOMFILTER_H_ */
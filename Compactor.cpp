@@ -0,0 +1,128 @@
+/**********************************
+ * FILE NAME: Compactor.cpp
+ *
+ * DESCRIPTION: Definition of the compaction threads shared by the nodes
+ **********************************/
+
+#include "Compactor.h"
+#include "KVStore.h"
+
+vector<thread> Compactor::threads;
+mutex Compactor::lock;
+condition_variable Compactor::wake;
+condition_variable Compactor::idle;
+deque<KVStore *> Compactor::waiting;
+vector<KVStore *> Compactor::running;
+bool Compactor::stopping = false;
+mutex Compactor::bucketLock;
+double Compactor::rate = 0;
+chrono::steady_clock::time_point Compactor::ready;
+
+/**
+ * FUNCTION NAME: start
+ *
+ * DESCRIPTION: Starts nthreads threads, sharing rate bytes per second, 0 unlimited
+ */
+void Compactor::start(int nthreads, long rate) {
+	Compactor::rate = rate;
+	ready = chrono::steady_clock::now();
+	stopping = false;
+	for ( int i = 0; i < nthreads; i++ ) {
+		threads.emplace_back(&Compactor::loop);
+	}
+}
+
+/**
+ * FUNCTION NAME: stop
+ *
+ * DESCRIPTION: Stops the threads once the stores are gone. Called once at the end of
+ * 				the program.
+ */
+void Compactor::stop() {
+	{
+		lock_guard<mutex> lk(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for ( size_t i = 0; i < threads.size(); i++ ) {
+		threads[i].join();
+	}
+	threads.clear();
+	waiting.clear();
+}
+
+/**
+ * FUNCTION NAME: submit
+ *
+ * DESCRIPTION: Queues the merge set up in the job of store
+ */
+void Compactor::submit(KVStore *store) {
+	{
+		lock_guard<mutex> lk(lock);
+		waiting.push_back(store);
+	}
+	wake.notify_one();
+}
+
+/**
+ * FUNCTION NAME: cancel
+ *
+ * DESCRIPTION: Drops the merge of store if it is waiting, or waits for its end if it
+ * 				is running. The store asks its merge to stop first.
+ */
+void Compactor::cancel(KVStore *store) {
+	unique_lock<mutex> lk(lock);
+
+	waiting.erase(remove(waiting.begin(), waiting.end(), store), waiting.end());
+	idle.wait(lk, [store] { return find(running.begin(), running.end(), store) == running.end(); });
+}
+
+/**
+ * FUNCTION NAME: throttle
+ *
+ * DESCRIPTION: Takes bytes from the token bucket, waiting until it holds them
+ */
+void Compactor::throttle(size_t bytes) {
+	chrono::steady_clock::time_point now, at;
+
+	if ( rate <= 0 ) {
+		return;
+	}
+	{
+		lock_guard<mutex> lk(bucketLock);
+		now = chrono::steady_clock::now();
+		if ( ready < now ) {
+			ready = now;
+		}
+		ready += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(bytes / rate));
+		at = ready - chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(COMPACT_BURST / rate));
+	}
+	if ( at > now ) {
+		this_thread::sleep_until(at);
+	}
+}
+
+/**
+ * FUNCTION NAME: loop
+ *
+ * DESCRIPTION: Body of a compaction thread
+ */
+void Compactor::loop() {
+	unique_lock<mutex> lk(lock);
+	KVStore *store;
+
+	while ( true ) {
+		wake.wait(lk, [] { return stopping || !waiting.empty(); });
+		if ( stopping ) {
+			return;
+		}
+		store = waiting.front();
+		waiting.pop_front();
+		running.push_back(store);
+		lk.unlock();
+		store->runCompaction();
+		lk.lock();
+		running.erase(find(running.begin(), running.end(), store));
+		idle.notify_all();
+	}
+}
@@ -0,0 +1,59 @@
+/**********************************
+ * FILE NAME: Compactor.h
+ *
+ * DESCRIPTION: Header file Compactor class
+ **********************************/
+
+#ifndef COMPACTOR_H_
+#define COMPACTOR_H_
+
+#include "stdincludes.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+
+/*
+ * Macros
+ */
+// bytes a merge may write at once, above COMPACT_RATE, after the bucket filled up
+#define COMPACT_BURST 65536
+
+class KVStore;
+
+/**
+ * CLASS NAME: Compactor
+ *
+ * DESCRIPTION: Threads merging the runs of every node. A store hands its merge over
+ * 				with submit and picks the result up at its own pace; the threads run
+ * 				the merges in the order they were submitted, one at a time per store.
+ *
+ * 				All the merges draw from one token bucket filled at COMPACT_RATE bytes
+ * 				per second, so the disk gives the merges that rate whatever the number
+ * 				of nodes or threads.
+ */
+class Compactor {
+private:
+	static vector<thread> threads;
+	static mutex lock;
+	static condition_variable wake, idle;
+	// stores with a merge waiting for a thread, and the ones being merged
+	static deque<KVStore *> waiting;
+	static vector<KVStore *> running;
+	static bool stopping;
+	// token bucket: bytes per second, and the time at which the bytes taken so far
+	// are paid for
+	static mutex bucketLock;
+	static double rate;
+	static chrono::steady_clock::time_point ready;
+	static void loop();
+public:
+	static void start(int nthreads, long rate);
+	static void stop();
+	static void submit(KVStore *store);
+	static void cancel(KVStore *store);
+	static void throttle(size_t bytes);
+};
+
+#endif /* COMPACTOR_H_ */
@@ -0,0 +1,38 @@
+/**********************************
+ * FILE NAME: Crc32.h
+ *
+ * DESCRIPTION: CRC-32 checksum of on-disk records
+ **********************************/
+
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+
+/**
+ * FUNCTION NAME: crc32
+ *
+ * DESCRIPTION: CRC-32 (IEEE, reflected) of n bytes, continuing from crc
+ */
+static inline uint32_t crc32(const char *p, size_t n, uint32_t crc = 0) {
+	static const vector<uint32_t> table = [] {
+		vector<uint32_t> t(256);
+		for ( uint32_t i = 0; i < 256; i++ ) {
+			uint32_t c = i;
+			for ( int k = 0; k < 8; k++ ) {
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			}
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for ( size_t i = 0; i < n; i++ ) {
+		crc = table[(crc ^ (uint8_t) p[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+#endif /* CRC32_H_ */
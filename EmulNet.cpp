@@ -9,19 +9,19 @@
 /**
  * Constructor
  */
-EmulNet::EmulNet(Params *p)
+EmulNet::EmulNet(Params *p, RandomStream stream)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
-	int i,j;
 	par = p;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			sent_msgs[i][j] = 0;
-			recv_msgs[i][j] = 0;
-		}
+	sent_msgs.init(par->EN_GPSZ);
+	recv_msgs.init(par->EN_GPSZ);
+	// mailboxes are never resized once nodes run in parallel
+	emulnet.initMailboxes(par->EN_GPSZ);
+	for ( int i = 0; i <= par->EN_GPSZ; i++ ) {
+		dropRng.push_back(par->rng(i, stream));
 	}
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
@@ -30,32 +30,26 @@ EmulNet::EmulNet(Params *p)
  * Copy constructor
  */
 EmulNet::EmulNet(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->sent_msgs = anotherEmulNet.sent_msgs;
+	this->recv_msgs = anotherEmulNet.recv_msgs;
 	this->emulnet = anotherEmulNet.emulnet;
+	this->outboxes.resize(anotherEmulNet.outboxes.size());
+	this->dropRng = anotherEmulNet.dropRng;
 }
 
 /**
  * Assignment operator overloading
  */
 EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->sent_msgs = anotherEmulNet.sent_msgs;
+	this->recv_msgs = anotherEmulNet.recv_msgs;
 	this->emulnet = anotherEmulNet.emulnet;
+	this->outboxes.resize(anotherEmulNet.outboxes.size());
+	this->dropRng = anotherEmulNet.dropRng;
 	return *this;
 }
 
@@ -77,44 +71,72 @@ void *EmulNet::ENinit(Address *myaddr, short port) {
 }
 
 /**
- * FUNCTION NAME: ENsend
+ * FUNCTION NAME: dropped
  *
- * DESCRIPTION: EmulNet send function
+ * DESCRIPTION: Decides whether a message is lost: network buffer full, message too
+ * 				big, or random drop drawn from the generator of the sender
+ */
+bool EmulNet::dropped(int from, int size) {
+	int sendmsg = dropRng[(from >= 0 && from < (int) dropRng.size()) ? from : 0].below(100);
+
+	return (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100));
+}
+
+/**
+ * FUNCTION NAME: deliver
+ *
+ * DESCRIPTION: Puts a message in the mailbox of its destination, or drops it if the
+ * 				destination id is out of range
  *
  * RETURNS:
- * size
+ * size, 0 if the message was dropped
  */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
-	en_msg *em;
-	static char temp[2048];
-	int sendmsg = rand() % 100;
+int EmulNet::deliver(en_msg &em) {
+	vector<en_msg> *mbox = emulnet.getMailbox(*(int *)(em.to.addr));
 
-	if( (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
+	// no node has this id, the message is lost
+	if ( !mbox ) {
+		MsgPool::release(em.data);
 		return 0;
 	}
+	mbox->push_back(em);
+	emulnet.currbuffsize++;
 
-	em = (en_msg *)malloc(sizeof(en_msg) + size);
-	em->size = size;
-
-	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
-	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
-	memcpy(em + 1, data, size);
-
-	emulnet.buff[emulnet.currbuffsize++] = em;
+	sent_msgs.inc(*(int *)(em.from.addr), par->getcurrtime());
 
-	int src = *(int *)(myaddr->addr);
-	int time = par->getcurrtime();
+	return em.size;
+}
 
-	assert(src <= MAX_NODES);
-	assert(time < MAX_TIME);
+/**
+ * FUNCTION NAME: ENsend
+ *
+ * DESCRIPTION: EmulNet send function. During a parallel phase the message goes to
+ * 				the outbox of the worker, it is delivered by ENflush.
+ *
+ * RETURNS:
+ * size
+ */
+int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
+	en_msg em;
+	int w = ThreadPool::worker;
 
-	sent_msgs[src][time]++;
+	if( w < 0 && dropped(*(int *)(myaddr->addr), size) ) {
+		return 0;
+	}
 
-	#ifdef DEBUGLOG
-		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
-	#endif
+	em.size = size;
+	em.from = *myaddr;
+	em.to = *toaddr;
+	em.data = MsgPool::alloc(size);
+	memcpy(em.data, data, size);
 
-	return size;
+	if( w >= 0 ) {
+		em.seq = ThreadPool::taskKey;
+		outboxes[w].push_back(em);
+		return size;
+	}
+	em.seq = 0;
+	return deliver(em);
 }
 
 /**
@@ -126,17 +148,14 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
  * size
  */
 int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
-	char * str = (char *) malloc(data.length() * sizeof(char));
-	memcpy(str, data.c_str(), data.size());
-	int ret = this->ENsend(myaddr, toaddr, str, (data.length() * sizeof(char)));
-	free(str);
-	return ret;
+	return this->ENsend(myaddr, toaddr, (char *) data.data(), (int) data.size());
 }
 
 /**
  * FUNCTION NAME: ENrecv
  *
- * DESCRIPTION: EmulNet receive function
+ * DESCRIPTION: EmulNet receive function. The message buffers are handed over to the
+ * 				queue without copying, the consumer releases them to MsgPool.
  *
  * RETURN:
  * 0
@@ -144,36 +163,53 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
 int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
 	// times is always assumed to be 1
 	int i;
-	char* tmp;
-	int sz;
-	en_msg *emsg;
+	vector<en_msg> pending;
+	vector<en_msg> *mbox = emulnet.getMailbox(*(int *)(myaddr->addr));
 
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
-
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
-
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
+	if ( !mbox || mbox->empty() ) {
+		return 0;
+	}
+	// Detach the mailbox so only this node's pending messages are touched
+	pending.swap(*mbox);
+	emulnet.currbuffsize -= pending.size();
 
-			(*enq)(queue, (char *)tmp, sz);
+	for( i = pending.size() - 1; i >= 0; i-- ) {
+		(*enq)(queue, pending[i].data, pending[i].size);
 
-			free(emsg);
+		recv_msgs.inc(*(int *)(myaddr->addr), par->getcurrtime());
+	}
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+	return 0;
+}
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+/**
+ * FUNCTION NAME: ENworkers
+ *
+ * DESCRIPTION: Sets up one outbox per worker of the tick engine
+ */
+void EmulNet::ENworkers(int n) {
+	outboxes.resize(n);
+}
 
-			recv_msgs[dst][time]++;
+/**
+ * FUNCTION NAME: ENflush
+ *
+ * DESCRIPTION: Delivers the messages of the outboxes at the end of a parallel phase,
+ * 				in the order the nodes would have sent them one after the other, then
+ * 				samples the message buffers in use
+ */
+void EmulNet::ENflush() {
+	ThreadPool::merge(outboxes, merged);
+	for ( size_t i = 0; i < merged.size(); i++ ) {
+		if ( dropped(*(int *)(merged[i].from.addr), merged[i].size) ) {
+			MsgPool::release(merged[i].data);
+		}
+		else {
+			deliver(merged[i]);
 		}
 	}
-
-	return 0;
+	merged.clear();
+	MsgPool::sample();
 }
 
 /**
@@ -184,13 +220,17 @@ int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct ti
 int EmulNet::ENcleanup() {
 	emulnet.nextid=0;
 	int i, j;
-	int sent_total, recv_total;
+	int sent, recv, sent_total, recv_total;
 
 	FILE* file = fopen("msgcount.log", "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	for ( i = 0; i < (int) emulnet.mbox.size(); i++ ) {
+		for ( j = 0; j < (int) emulnet.mbox[i].size(); j++ ) {
+			MsgPool::release(emulnet.mbox[i][j].data);
+		}
+		emulnet.mbox[i].clear();
 	}
+	emulnet.currbuffsize = 0;
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
 		fprintf(file, "node %3d ", i);
@@ -199,21 +239,24 @@ int EmulNet::ENcleanup() {
 
 		for (j = 0; j < par->getcurrtime(); j++) {
 
-			sent_total += sent_msgs[i][j];
-			recv_total += recv_msgs[i][j];
+			sent = sent_msgs.get(i, j);
+			recv = recv_msgs.get(i, j);
+			sent_total += sent;
+			recv_total += recv;
 			if (i != 67) {
-				fprintf(file, " (%4d, %4d)", sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, " (%4d, %4d)", sent, recv);
 				if (j % 10 == 9) {
 					fprintf(file, "\n         ");
 				}
 			}
 			else {
-				fprintf(file, "special %4d %4d %4d\n", j, sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, "special %4d %4d %4d\n", j, sent, recv);
 			}
 		}
 		fprintf(file, "\n");
 		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
 	}
+	MsgPool::printStats(file);
 
 	fclose(file);
 	return 0;
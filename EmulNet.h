@@ -7,13 +7,13 @@
 #ifndef _EMULNET_H_
 #define _EMULNET_H_
 
-#define MAX_NODES 1000
-#define MAX_TIME 3600
 #define ENBUFFSIZE 30000
 
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "MsgPool.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
@@ -21,12 +21,16 @@ using namespace std;
  * Struct Name: en_msg
  */
 typedef struct en_msg {
-	// Number of bytes after the class
+	// Number of bytes in data
 	int size;
 	// Source node
 	Address from;
 	// Destination node
 	Address to;
+	// Payload, a MsgPool buffer owned by this message until delivered
+	char *data;
+	// Position of the sending node in its phase, orders the merge of the outboxes
+	int seq;
 }en_msg;
 
 /**
@@ -35,21 +39,29 @@ typedef struct en_msg {
 class EM {
 public:
 	int nextid;
-	int currbuffsize;
+	atomic<int> currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
+	// Pending messages, one mailbox per destination node id
+	vector< vector<en_msg> > mbox;
 	EM() {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->mbox = anotherEM.mbox;
 		return *this;
 	}
+	// one mailbox for each id up to maxid, made once before the nodes run
+	void initMailboxes(int maxid) {
+		mbox.resize(maxid + 1);
+	}
+	// NULL for an id no node can have
+	vector<en_msg> *getMailbox(int id) {
+		if ( id < 0 || id >= (int) mbox.size() ) {
+			return NULL;
+		}
+		return &mbox[id];
+	}
 	int getNextId() {
 		return nextid;
 	}
@@ -71,6 +83,40 @@ public:
 	virtual ~EM() {}
 };
 
+/**
+ * CLASS NAME: MsgCounter
+ *
+ * DESCRIPTION: Per node message counts, one bucket per time unit.
+ * 				Rows and buckets are only allocated when a node sends or receives.
+ */
+class MsgCounter {
+private:
+	vector< vector<int> > cnt;
+public:
+	MsgCounter() {}
+	void init(int nodes) {
+		cnt.assign(nodes + 1, vector<int>());
+	}
+	void inc(int node, int time) {
+		if ( node < 0 || time < 0 ) {
+			return;
+		}
+		if ( node >= (int) cnt.size() ) {
+			cnt.resize(node + 1);
+		}
+		if ( time >= (int) cnt[node].size() ) {
+			cnt[node].resize(time + 1, 0);
+		}
+		cnt[node][time]++;
+	}
+	int get(int node, int time) {
+		if ( node < 0 || node >= (int) cnt.size() || time < 0 || time >= (int) cnt[node].size() ) {
+			return 0;
+		}
+		return cnt[node][time];
+	}
+};
+
 /**
  * CLASS NAME: EmulNet
  *
@@ -80,12 +126,19 @@ class EmulNet
 { 	
 private:
 	Params* par;
-	int sent_msgs[MAX_NODES + 1][MAX_TIME];
-	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	MsgCounter sent_msgs;
+	MsgCounter recv_msgs;
 	int enInited;
 	EM emulnet;
+	// Messages sent by the nodes run by each worker during a parallel phase
+	vector< vector<en_msg> > outboxes;
+	vector<en_msg> merged;
+	// drop draws, one generator per sending node
+	vector<Random> dropRng;
+	bool dropped(int from, int size);
+	int deliver(en_msg &em);
 public:
- 	EmulNet(Params *p);
+ 	EmulNet(Params *p, RandomStream stream);
  	EmulNet(EmulNet &anotherEmulNet);
  	EmulNet& operator = (EmulNet &anotherEmulNet);
  	virtual ~EmulNet();
@@ -94,6 +147,8 @@ public:
 	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
 	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
 	int ENcleanup();
+	void ENworkers(int n);
+	void ENflush();
 };
 
 #endif /* _EMULNET_H_ */
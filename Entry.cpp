@@ -9,7 +9,6 @@
  * constructor
  */
 Entry::Entry(string _value, int _timestamp, ReplicaType _replica){
-	this->delimiter = ":";
 	value = _value;
 	timestamp = _timestamp;
 	replica = _replica;
@@ -22,13 +21,12 @@ Entry::Entry(string _value, int _timestamp, ReplicaType _replica){
  */
 Entry::Entry(string entry){
 	vector<string> tuple;
-	this->delimiter = ":";
 	size_t pos = entry.find(delimiter);
 	size_t start = 0;
 	while (pos != string::npos) {
 		string field = entry.substr(start, pos-start);
 		tuple.push_back(field);
-		start = pos + delimiter.size();
+		start = pos + 1;
 		pos = entry.find(delimiter, start);
 	}
 	tuple.push_back(entry.substr(start));
@@ -46,3 +44,64 @@ Entry::Entry(string entry){
 string Entry::convertToString() {
 	return value + delimiter + to_string(timestamp) + delimiter + to_string(replica);
 }
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Binary form of the entry, as stored by the replicas
+ */
+string Entry::encode() {
+	string data;
+	encode(data, timestamp, value, replica);
+	return data;
+}
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Binary form of an entry into data, which keeps its capacity from one
+ * 				entry to the next. An empty value is stored as a tombstone.
+ */
+void Entry::encode(string &data, int timestamp, string_view value, ReplicaType replica) {
+	data.resize(ENTRY_HDRSZ + value.size());
+	data[0] = value.empty() ? ENTRY_TOMBSTONE : ENTRY_VALUE;
+	memcpy(&data[1], &timestamp, sizeof(int));
+	data[5] = (char) replica;
+	memcpy(&data[ENTRY_HDRSZ], value.data(), value.size());
+}
+
+/**
+ * FUNCTION NAME: decode
+ *
+ * DESCRIPTION: Reads the timestamp and the value of an entry stored by encode. value
+ * 				points into data, it is empty for a tombstone.
+ *
+ * RETURNS:
+ * false if data is not an entry
+ */
+bool Entry::decode(string_view data, int *timestamp, string_view *value) {
+	if ( data.size() < ENTRY_HDRSZ || (data[0] != ENTRY_VALUE && data[0] != ENTRY_TOMBSTONE) ) {
+		return false;
+	}
+	memcpy(timestamp, data.data() + 1, sizeof(int));
+	*value = (data[0] == ENTRY_VALUE) ? data.substr(ENTRY_HDRSZ) : string_view();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: newer
+ *
+ * DESCRIPTION: Last write wins: returns true if the first version supersedes the
+ * 				second. An empty value is a delete, which supersedes a value of the
+ * 				same time. Writes of the same time are ordered by their values, so
+ * 				that every coordinator settles on the same one.
+ */
+bool Entry::newer(int timestamp, string_view value, int thanTimestamp, string_view thanValue) {
+	if ( timestamp != thanTimestamp ) {
+		return timestamp > thanTimestamp;
+	}
+	if ( value.empty() != thanValue.empty() ) {
+		return value.empty();
+	}
+	return value > thanValue;
+}
@@ -4,22 +4,49 @@
  * DESCRIPTION: Header file Entry class
  **********************************/
 
+#ifndef ENTRY_H_
+#define ENTRY_H_
+
 #include "stdincludes.h"
 #include "Message.h"
 
+/*
+ * Macros
+ */
+// stored form of an entry: type(1) timestamp(4) replica(1) value
+#define ENTRY_HDRSZ 6
+// entry types, as the record types of KVStore
+#define ENTRY_VALUE 'V'
+#define ENTRY_TOMBSTONE 'T'
+
 /**
  * CLASS NAME: Entry
  *
- * DESCRIPTION: This class describes the entry for each key in the DHT
+ * DESCRIPTION: This class describes the entry for each key in the DHT. The
+ * 				timestamp is the version of the value: the time of the write that
+ * 				made it, given by its coordinator.
+ *
+ * 				A delete leaves a tombstone, an entry of type ENTRY_TOMBSTONE with
+ * 				no value and the version of the delete, so that a late write or a
+ * 				replica that missed the delete cannot bring the key back. Outside the
+ * 				store, in replies, repairs and hints, a delete is an empty value with
+ * 				its version.
  */
 class Entry{
 public:
 	string value;
 	int timestamp;
 	ReplicaType replica;
-	string delimiter;
+	static const char delimiter = ':';
 
 	Entry(string entry);
 	Entry(string _value, int _timestamp, ReplicaType _replica);
 	string convertToString();
+	// binary form kept by the replicas, the value may hold any byte
+	string encode();
+	static void encode(string &data, int timestamp, string_view value, ReplicaType replica);
+	static bool decode(string_view data, int *timestamp, string_view *value);
+	static bool newer(int timestamp, string_view value, int thanTimestamp, string_view thanValue);
 };
+
+#endif /* ENTRY_H_ */
@@ -6,10 +6,173 @@
 
 #include "HashTable.h"
 
-HashTable::HashTable() {}
+// two slots per cache line
+static_assert(sizeof(ht_slot) == 32, "ht_slot is not 32 bytes");
+
+HashTable::HashTable(): slots(HASHTABLE_MINSZ), mask(HASHTABLE_MINSZ - 1), nkeys(0), garbage(0) {}
 
 HashTable::~HashTable() {}
 
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Returns the slot holding key, -1 if it is not in the table
+ */
+long HashTable::lookup(string_view key) {
+	uint32_t h = hashOf(key);
+	size_t i = h & mask;
+	uint32_t dist;
+
+	for ( dist = 1; ; dist++, i = (i + 1) & mask ) {
+		ht_slot &s = slots[i];
+		if ( s.dist < dist ) {
+			// free slot, or an entry closer to home than key would be
+			return -1;
+		}
+		if ( s.hash == h && keyOf(s) == key ) {
+			return (long) i;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: store
+ *
+ * DESCRIPTION: Writes key and value in slot s, in place when they fit, otherwise
+ * 				at the end of the arena
+ */
+void HashTable::store(ht_slot &s, string_view key, string_view value) {
+	if ( key.size() + value.size() <= HT_INLINE ) {
+		s.klen = (uint8_t) key.size();
+		s.vlen = (uint8_t) value.size();
+		memcpy(s.inl, key.data(), key.size());
+		memcpy(s.inl + key.size(), value.data(), value.size());
+		return;
+	}
+	s.klen = s.vlen = HT_SPILLED;
+	s.spill.off = (uint32_t) arena.size();
+	s.spill.klen = (uint32_t) key.size();
+	s.spill.vlen = (uint32_t) value.size();
+	arena.insert(arena.end(), key.begin(), key.end());
+	arena.insert(arena.end(), value.begin(), value.end());
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Accounts the arena bytes of slot s as garbage
+ */
+void HashTable::release(ht_slot &s) {
+	if ( spilled(s) ) {
+		garbage += s.spill.klen + s.spill.vlen;
+	}
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: Copies the live arena entries to a new arena once half of it is garbage
+ */
+void HashTable::compact() {
+	vector<char> fresh;
+
+	if ( arena.size() < HT_ARENA_MIN || garbage * 2 < arena.size() ) {
+		return;
+	}
+	fresh.reserve(arena.size() - garbage);
+	for ( size_t i = 0; i < slots.size(); i++ ) {
+		ht_slot &s = slots[i];
+		if ( s.dist && spilled(s) ) {
+			const char *p = &arena[s.spill.off];
+			s.spill.off = (uint32_t) fresh.size();
+			fresh.insert(fresh.end(), p, p + s.spill.klen + s.spill.vlen);
+		}
+	}
+	arena.swap(fresh);
+	garbage = 0;
+}
+
+/**
+ * FUNCTION NAME: place
+ *
+ * DESCRIPTION: Moves an entry known not to be in the table into it, probing from
+ * 				slot i where its distance is entry.dist
+ */
+void HashTable::place(ht_slot &entry, size_t i) {
+	for ( ; ; entry.dist++, i = (i + 1) & mask ) {
+		ht_slot &s = slots[i];
+		if ( s.dist == 0 ) {
+			s = entry;
+			nkeys++;
+			return;
+		}
+		if ( s.dist < entry.dist ) {
+			// take the slot, carry on with the entry that was there
+			swap(s, entry);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: grow
+ *
+ * DESCRIPTION: Doubles the number of slots
+ */
+void HashTable::grow() {
+	vector<ht_slot> old(slots.size() * 2);
+
+	old.swap(slots);
+	mask = slots.size() - 1;
+	nkeys = 0;
+	for ( size_t i = 0; i < old.size(); i++ ) {
+		if ( old[i].dist ) {
+			old[i].dist = 1;
+			place(old[i], old[i].hash & mask);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Inserts the pair if key is not in the table. Otherwise the value is
+ * 				replaced when overwrite is set. Both cases take a single probe.
+ *
+ * RETURNS:
+ * true if key was inserted
+ * false if it was already there
+ */
+bool HashTable::put(string_view key, string_view value, bool overwrite) {
+	ht_slot entry;
+	uint32_t h;
+	size_t i;
+
+	if ( (nkeys + 1) * 8 > slots.size() * 7 ) {
+		grow();
+	}
+	h = hashOf(key);
+	i = h & mask;
+	for ( entry.dist = 1; ; entry.dist++, i = (i + 1) & mask ) {
+		ht_slot &s = slots[i];
+		if ( s.dist < entry.dist ) {
+			break;
+		}
+		if ( s.hash == h && keyOf(s) == key ) {
+			if ( overwrite ) {
+				release(s);
+				store(s, key, value);
+				compact();
+			}
+			return false;
+		}
+	}
+	// key is not there, it goes in slot i
+	entry.hash = h;
+	store(entry, key, value);
+	place(entry, i);
+	return true;
+}
+
 /**
  * FUNCTION NAME: create
  *
@@ -17,11 +180,10 @@ HashTable::~HashTable() {}
  *
  * RETURNS:
  * true on SUCCESS
- * false in FAILURE
+ * false in FAILURE, key already in the table
  */
-bool HashTable::create(string key, string value) {
-	hashTable.emplace(key, value);
-	return true;
+bool HashTable::create(string_view key, string_view value) {
+	return put(key, value, false);
 }
 
 /**
@@ -33,13 +195,12 @@ bool HashTable::create(string key, string value) {
  * string value if found
  * else it returns a NULL
  */
-string HashTable::read(string key) {
-	map<string, string>::iterator search;
+string HashTable::read(string_view key) {
+	string_view value;
 
-	search = hashTable.find(key);
-	if ( search != hashTable.end() ) {
+	if ( find(key, value) ) {
 		// Value found
-		return search->second;
+		return string(value);
 	}
 	else {
 		// Value not found
@@ -47,6 +208,24 @@ string HashTable::read(string key) {
 	}
 }
 
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Sets value to a view of the value of key, valid until the table is changed
+ *
+ * RETURNS:
+ * true if key was found
+ */
+bool HashTable::find(string_view key, string_view &value) {
+	long i = lookup(key);
+
+	if ( i < 0 ) {
+		return false;
+	}
+	value = valueOf(slots[i]);
+	return true;
+}
+
 /**
  * FUNCTION NAME: update
  *
@@ -57,20 +236,33 @@ string HashTable::read(string key) {
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::update(string key, string newValue) {
-	map<string, string>::iterator update;
+bool HashTable::update(string_view key, string_view newValue) {
+	long i = lookup(key);
 
-	if (read(key).empty()) {
+	if ( i < 0 ) {
 		// Key not found
 		return false;
 	}
-	// Key found
-	//update = hashTable.at(key) = newValue;
-	hashTable.at(key) = newValue;
-	// Update successful
+	// Update successful, key is the same as the one stored
+	release(slots[i]);
+	store(slots[i], key, newValue);
+	compact();
 	return true;
 }
 
+/**
+ * FUNCTION NAME: upsert
+ *
+ * DESCRIPTION: Sets the value of key, inserting it if needed
+ *
+ * RETURNS:
+ * true if key was inserted
+ * false if an existing value was replaced
+ */
+bool HashTable::upsert(string_view key, string_view value) {
+	return put(key, value, true);
+}
+
 /**
  * FUNCTION NAME: deleteKey
  *
@@ -80,18 +272,24 @@ bool HashTable::update(string key, string newValue) {
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::deleteKey(string key) {
-	uint eraseCount = 0;
+bool HashTable::deleteKey(string_view key) {
+	long found = lookup(key);
+	size_t i, next;
 
-	if (read(key).empty()) {
+	if ( found < 0 ) {
 		// Key not found
 		return false;
 	}
-	eraseCount = hashTable.erase(key);
-	if ( eraseCount < 1 ) {
-		// Could not erase
-		return false;
+	// shift back the rest of the cluster
+	i = (size_t) found;
+	release(slots[i]);
+	for ( next = (i + 1) & mask; slots[next].dist > 1; i = next, next = (next + 1) & mask ) {
+		slots[i] = slots[next];
+		slots[i].dist--;
 	}
+	slots[i].dist = 0;
+	nkeys--;
+	compact();
 	// Delete was successful
 	return true;
 }
@@ -106,7 +304,7 @@ bool HashTable::deleteKey(string key) {
  * false otherwise
  */
 bool HashTable::isEmpty() {
-	return hashTable.empty();
+	return nkeys == 0;
 }
 
 /**
@@ -118,7 +316,31 @@ bool HashTable::isEmpty() {
  * size of the table as unit
  */
 unsigned long HashTable::currentSize() {
-	return (unsigned  long)hashTable.size();
+	return nkeys;
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the bytes held by the table, slots and arena
+ */
+unsigned long HashTable::memoryBytes() {
+	return slots.size() * sizeof(ht_slot) + arena.capacity();
+}
+
+/**
+ * FUNCTION NAME: inlineKeys
+ *
+ * DESCRIPTION: Returns the number of entries kept in their slot, outside the arena
+ */
+unsigned long HashTable::inlineKeys() {
+	unsigned long n = 0;
+	for ( size_t i = 0; i < slots.size(); i++ ) {
+		if ( slots[i].dist && !spilled(slots[i]) ) {
+			n++;
+		}
+	}
+	return n;
 }
 
 /**
@@ -127,7 +349,11 @@ unsigned long HashTable::currentSize() {
  * DESCRIPTION: Clear all contents from the hash table
  */
 void HashTable::clear() {
-	hashTable.clear();
+	vector<ht_slot>(HASHTABLE_MINSZ).swap(slots);
+	mask = HASHTABLE_MINSZ - 1;
+	nkeys = 0;
+	vector<char>().swap(arena);
+	garbage = 0;
 }
 
 /**
@@ -138,7 +364,6 @@ void HashTable::clear() {
  * RETURNS:
  * unsigned long count (Should be always 1)
  */
-unsigned long HashTable::count(string key) {
-	return (unsigned long) hashTable.count(key);
+unsigned long HashTable::count(string_view key) {
+	return (lookup(key) < 0) ? 0 : 1;
 }
-
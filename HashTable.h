@@ -11,29 +11,128 @@
  * Header files
  */
 #include "stdincludes.h"
+#include <stdint.h>
+#include <string_view>
 #include "common.h"
 #include "Entry.h"
 
+/*
+ * Macros
+ */
+// initial number of slots, always a power of two
+#define HASHTABLE_MINSZ 16
+// key and value bytes kept in the slot itself, room for a KEY_LENGTH key and an
+// encoded entry of a short value
+#define HT_INLINE 24
+// length mark of an entry stored in the arena
+#define HT_SPILLED 255
+// the arena is compacted when half of it is garbage, once past this size
+#define HT_ARENA_MIN 4096
+
+/**
+ * STRUCT NAME: ht_slot
+ *
+ * DESCRIPTION: Slot of the table, 32 bytes. dist is one plus the distance of the
+ * 				entry from its home slot, 0 for a free slot. hash is kept to skip
+ * 				most key compares and to rehash without hashing the keys again.
+ * 				The key is followed by the value, in inl when both fit, otherwise
+ * 				at spill.off in the arena.
+ */
+typedef struct ht_slot {
+	uint32_t hash;
+	uint16_t dist;
+	// lengths of an inline entry, klen is HT_SPILLED for an entry in the arena
+	uint8_t klen;
+	uint8_t vlen;
+	union {
+		char inl[HT_INLINE];
+		struct {
+			uint32_t off;
+			uint32_t klen;
+			uint32_t vlen;
+		} spill;
+	};
+} ht_slot;
+
 /**
  * CLASS NAME: HashTable
  *
- * DESCRIPTION: This class is a wrapper to the map provided by C++ STL.
+ * DESCRIPTION: Key value store of a node. Robin Hood open addressing: an entry being
+ * 				inserted takes the slot of any entry closer to its home, so probe
+ * 				lengths stay short and a lookup stops as soon as it meets an entry
+ * 				closer to home than the key would be. Erased slots are filled back by
+ * 				shifting the rest of the cluster, there are no tombstones. Grows when
+ * 				7/8 full.
  *
+ * 				Short entries live in their slot, longer ones in a byte arena of the
+ * 				table, so no entry owns a heap block. Space left in the arena by
+ * 				erased or rewritten entries is reclaimed by compacting it.
+ *
+ * 				Lookups take a string_view, so callers holding a char buffer or a
+ * 				message field do not build a string. Every operation probes once.
+ * 				Views returned by the table are valid until it is changed, and views
+ * 				passed to it must not point into it.
  */
 class HashTable {
+private:
+	vector<ht_slot> slots;
+	size_t mask;
+	unsigned long nkeys;
+	vector<char> arena;
+	// arena bytes no longer referenced by any slot
+	size_t garbage;
+	static uint32_t hashOf(string_view key) {
+		return (uint32_t) hash<string_view>()(key);
+	}
+	static bool spilled(const ht_slot &s) {
+		return s.klen == HT_SPILLED;
+	}
+	const char *bytes(const ht_slot &s) {
+		return spilled(s) ? &arena[s.spill.off] : s.inl;
+	}
+	string_view keyOf(const ht_slot &s) {
+		return string_view(bytes(s), spilled(s) ? s.spill.klen : s.klen);
+	}
+	string_view valueOf(const ht_slot &s) {
+		return string_view(bytes(s) + (spilled(s) ? s.spill.klen : s.klen), spilled(s) ? s.spill.vlen : s.vlen);
+	}
+	long lookup(string_view key);
+	bool put(string_view key, string_view value, bool overwrite);
+	void store(ht_slot &s, string_view key, string_view value);
+	void release(ht_slot &s);
+	void compact();
+	void place(ht_slot &entry, size_t i);
+	void grow();
 public:
-	map<string, string> hashTable;
-//public:
 	HashTable();
-	bool create(string key, string value);
-	string read(string key);
-	bool update(string key, string newValue);
-	bool deleteKey(string key);
+	bool create(string_view key, string_view value);
+	string read(string_view key);
+	bool find(string_view key, string_view &value);
+	bool update(string_view key, string_view newValue);
+	bool upsert(string_view key, string_view value);
+	bool deleteKey(string_view key);
 	bool isEmpty();
 	unsigned long currentSize();
+	unsigned long memoryBytes();
+	unsigned long inlineKeys();
 	void clear();
-	unsigned long count(string key);
+	unsigned long count(string_view key);
 	virtual ~HashTable();
+
+	/**
+	 * FUNCTION NAME: forEach
+	 *
+	 * DESCRIPTION: Calls f(key, value) for every entry, as string_views. f must not
+	 * 				change the table.
+	 */
+	template <class F>
+	void forEach(F f) {
+		for ( size_t i = 0; i < slots.size(); i++ ) {
+			if ( slots[i].dist ) {
+				f(keyOf(slots[i]), valueOf(slots[i]));
+			}
+		}
+	}
 };
 
 #endif /* HASHTABLE_H_ */
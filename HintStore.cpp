@@ -0,0 +1,284 @@
+/**********************************
+ * FILE NAME: HintStore.cpp
+ *
+ * DESCRIPTION: Definition of the hinted handoff store
+ **********************************/
+
+#include "HintStore.h"
+#include <sys/stat.h>
+
+/**
+ * Constructor
+ */
+HintStore::HintStore(Params *par, int node): par(par), node(node), memBytes(0), stored(0), spilled(0), replayed(0), dropped(0) {
+}
+
+/**
+ * Destructor. Undelivered hints are lost with their spill files.
+ */
+HintStore::~HintStore() {
+	while ( !targets.empty() ) {
+		release(targets.size() - 1);
+	}
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Returns the hints of the replica at addr, NULL if there are none
+ */
+hint_target *HintStore::find(Address &addr) {
+	for ( size_t i = 0; i < targets.size(); i++ ) {
+		if ( targets[i].addr == addr ) {
+			return &targets[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * FUNCTION NAME: spillPath
+ *
+ * DESCRIPTION: Returns the file name of the spill of the hints of this node for addr
+ */
+string HintStore::spillPath(Address &addr) {
+	char path[128];
+	int id;
+
+	memcpy(&id, &addr.addr[0], sizeof(int));
+	snprintf(path, sizeof(path), "%s/node%d-hints-%d.log", par->DATA_DIR, node, id);
+	return path;
+}
+
+/**
+ * FUNCTION NAME: spillOldest
+ *
+ * DESCRIPTION: Moves the oldest hint of t held in memory to its spill file, which is
+ * 				opened, and emptied of what a previous run left, on first use
+ *
+ * RETURNS:
+ * false if t has nothing in memory or the spill cannot be written
+ */
+bool HintStore::spillOldest(hint_target &t) {
+	string typed;
+
+	if ( t.mem.empty() ) {
+		return false;
+	}
+	if ( !t.spill ) {
+		mkdir(par->DATA_DIR, 0755);
+		t.spill = new Wal(spillPath(t.addr).c_str(), false);
+		if ( !t.spill->isOpen() || !t.spill->reset() ) {
+			perror(spillPath(t.addr).c_str());
+			delete t.spill;
+			t.spill = NULL;
+			return false;
+		}
+		t.spillPos = 0;
+		t.spilled = 0;
+	}
+	hint &h = t.mem.front();
+	typed.resize(HINT_SPILL_HDRSZ);
+	typed[0] = (char) h.type;
+	memcpy(&typed[1], &h.timestamp, sizeof(int));
+	typed.append(h.value);
+	t.spill->append(WAL_PUT, h.key, typed);
+	memBytes -= HINT_OVERHEAD + h.key.size() + h.value.size();
+	t.mem.pop_front();
+	t.spilled++;
+	spilled++;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Forgets the replica targets[i] and its hints
+ */
+void HintStore::release(size_t i) {
+	hint_target &t = targets[i];
+
+	for ( size_t j = 0; j < t.mem.size(); j++ ) {
+		memBytes -= HINT_OVERHEAD + t.mem[j].key.size() + t.mem[j].value.size();
+	}
+	dropped += t.mem.size() + t.spilled;
+	if ( t.spill ) {
+		delete t.spill;
+		unlink(spillPath(t.addr).c_str());
+	}
+	targets.erase(targets.begin() + i);
+}
+
+/**
+ * FUNCTION NAME: markDown
+ *
+ * DESCRIPTION: The replica at addr is suspected, writes to it are kept as hints and
+ * 				their delivery stops
+ */
+void HintStore::markDown(Address &addr) {
+	hint_target *t = find(addr);
+
+	if ( !t ) {
+		targets.emplace_back();
+		t = &targets.back();
+		t->addr = addr;
+		t->spill = NULL;
+		t->spillPos = 0;
+		t->spilled = 0;
+	}
+	t->down = true;
+}
+
+/**
+ * FUNCTION NAME: markUp
+ *
+ * DESCRIPTION: The replica at addr is alive again, its hints are delivered from the
+ * 				next replay
+ */
+void HintStore::markUp(Address &addr) {
+	hint_target *t = find(addr);
+
+	if ( t ) {
+		t->down = false;
+	}
+}
+
+/**
+ * FUNCTION NAME: isDown
+ *
+ * DESCRIPTION: Returns true if writes to the replica at addr must be kept as hints
+ */
+bool HintStore::isDown(Address &addr) {
+	hint_target *t = find(addr);
+
+	return t && t->down;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Keeps a write for the replica at addr. Past HINT_MEMORY the oldest
+ * 				hints in memory are spilled, those of addr first.
+ */
+void HintStore::add(Address &addr, MessageType type, string_view key, string_view value, int timestamp) {
+	hint_target *t = find(addr);
+
+	if ( !t ) {
+		markDown(addr);
+		t = find(addr);
+	}
+	t->mem.push_back(hint{type, timestamp, string(key), string(value)});
+	memBytes += HINT_OVERHEAD + key.size() + value.size();
+	stored++;
+	while ( memBytes > (unsigned long) par->HINT_MEMORY && spillOldest(*t) );
+	for ( size_t i = 0; memBytes > (unsigned long) par->HINT_MEMORY && i < targets.size(); i++ ) {
+		while ( memBytes > (unsigned long) par->HINT_MEMORY && spillOldest(targets[i]) );
+	}
+	for ( size_t i = 0; i < targets.size(); i++ ) {
+		if ( targets[i].spill ) {
+			targets[i].spill->commit();
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: replay
+ *
+ * DESCRIPTION: Calls send for up to HINT_BATCH hints of every replica that is not
+ * 				down, in the order they were added, and forgets the replicas left
+ * 				without hints
+ *
+ * RETURNS:
+ * number of hints delivered
+ */
+long HintStore::replay(function<void(Address &, MessageType, string_view, string_view, int)> send) {
+	long total = 0, n, sent;
+
+	for ( size_t i = targets.size(); i-- > 0; ) {
+		hint_target &t = targets[i];
+		if ( t.down ) {
+			continue;
+		}
+		sent = 0;
+		if ( t.spilled > 0 ) {
+			n = t.spill->readAt(t.spillPos, min((long) par->HINT_BATCH, t.spilled), [&](WalOp op, string_view key, string_view typed) {
+				int timestamp;
+				memcpy(&timestamp, &typed[1], sizeof(int));
+				send(t.addr, (MessageType) typed[0], key, typed.substr(HINT_SPILL_HDRSZ), timestamp);
+			});
+			if ( n == 0 ) {
+				// a record that cannot be read back is lost with the rest of the spill
+				dropped += t.spilled;
+				t.spilled = 0;
+			}
+			t.spilled -= n;
+			sent += n;
+			if ( t.spilled == 0 ) {
+				t.spill->reset();
+				t.spillPos = 0;
+			}
+		}
+		while ( t.spilled == 0 && sent < par->HINT_BATCH && !t.mem.empty() ) {
+			hint &h = t.mem.front();
+			send(t.addr, h.type, h.key, h.value, h.timestamp);
+			memBytes -= HINT_OVERHEAD + h.key.size() + h.value.size();
+			t.mem.pop_front();
+			sent++;
+		}
+		replayed += sent;
+		total += sent;
+		if ( t.spilled == 0 && t.mem.empty() ) {
+			release(i);
+		}
+	}
+	return total;
+}
+
+/**
+ * FUNCTION NAME: drop
+ *
+ * DESCRIPTION: Forgets the hints of the replica at addr, which left the ring
+ */
+void HintStore::drop(Address &addr) {
+	for ( size_t i = 0; i < targets.size(); i++ ) {
+		if ( targets[i].addr == addr ) {
+			release(i);
+			return;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Forgets every hint, the membership list was reset
+ */
+void HintStore::clear() {
+	while ( !targets.empty() ) {
+		release(targets.size() - 1);
+	}
+}
+
+/**
+ * FUNCTION NAME: pending
+ *
+ * DESCRIPTION: Returns the number of hints not delivered yet
+ */
+unsigned long HintStore::pending() {
+	unsigned long n = 0;
+
+	for ( size_t i = 0; i < targets.size(); i++ ) {
+		n += targets[i].mem.size() + targets[i].spilled;
+	}
+	return n;
+}
+
+/**
+ * FUNCTION NAME: logStats
+ *
+ * DESCRIPTION: Writes the hinted handoff statistics to the stats log
+ */
+void HintStore::logStats(Log *log, Address *addr) {
+	log->LOG(addr, "#STATSLOG# hints stored %ld spilled %ld replayed %ld dropped %ld pending %lu memory bytes %lu",
+			stored, spilled, replayed, dropped, pending(), memBytes);
+}
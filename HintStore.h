@@ -0,0 +1,95 @@
+/**********************************
+ * FILE NAME: HintStore.h
+ *
+ * DESCRIPTION: Hinted handoff of the writes meant for replicas that are down
+ **********************************/
+
+#ifndef HINTSTORE_H_
+#define HINTSTORE_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Log.h"
+#include "Member.h"
+#include "Wal.h"
+#include "common.h"
+#include <deque>
+
+/*
+ * Macros
+ */
+// bookkeeping bytes counted for every hint held in memory, besides its key and value
+#define HINT_OVERHEAD 48
+// spilled value: type(1) timestamp(4) value
+#define HINT_SPILL_HDRSZ 5
+
+/**
+ * STRUCT NAME: hint
+ *
+ * DESCRIPTION: A write to deliver to a replica once it is back
+ */
+typedef struct hint {
+	MessageType type;
+	int timestamp;
+	string key;
+	string value;
+} hint;
+
+/**
+ * STRUCT NAME: hint_target
+ *
+ * DESCRIPTION: The hints of one replica, oldest first. The spill holds the oldest
+ * 				ones, those in memory are all newer.
+ */
+typedef struct hint_target {
+	Address addr;
+	// suspected by the membership protocol, its writes are kept here
+	bool down;
+	deque<hint> mem;
+	Wal *spill;
+	// next record of the spill to deliver, and the records after it
+	uint64_t spillPos;
+	long spilled;
+} hint_target;
+
+/**
+ * CLASS NAME: HintStore
+ *
+ * DESCRIPTION: Hinted handoff. The coordinator of a write keeps the writes meant
+ * 				for the replicas the membership protocol suspects, instead of sending
+ * 				them, and delivers them in batches of HINT_BATCH per time unit once
+ * 				the replica is reported alive again. Hints are held in memory up to
+ * 				HINT_MEMORY bytes for the whole node; past that the oldest ones go to
+ * 				a spill file per replica, written like the write-ahead log. The
+ * 				spill only relieves memory, it is not read back after a restart.
+ * 				The hints of a replica that leaves the ring are dropped: the
+ * 				stabilization protocol copies its keys to the new replicas.
+ */
+class HintStore {
+private:
+	Params *par;
+	int node;
+	vector<hint_target> targets;
+	unsigned long memBytes;
+	// statistics
+	long stored, spilled, replayed, dropped;
+	hint_target *find(Address &addr);
+	string spillPath(Address &addr);
+	bool spillOldest(hint_target &t);
+	void release(size_t i);
+public:
+	HintStore(Params *par, int node);
+	virtual ~HintStore();
+	void markDown(Address &addr);
+	void markUp(Address &addr);
+	bool isDown(Address &addr);
+	void add(Address &addr, MessageType type, string_view key, string_view value, int timestamp);
+	long replay(function<void(Address &, MessageType, string_view, string_view, int)> send);
+	void drop(Address &addr);
+	void clear();
+	unsigned long pending();
+	unsigned long memoryBytes() { return memBytes; }
+	void logStats(Log *log, Address *addr);
+};
+
+#endif /* HINTSTORE_H_ */
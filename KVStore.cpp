@@ -0,0 +1,646 @@
+/**********************************
+ * FILE NAME: KVStore.cpp
+ *
+ * DESCRIPTION: Definition of the storage engine
+ **********************************/
+
+#include "KVStore.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <chrono>
+
+/**
+ * Constructor. Opens the runs and the log of the node found in DATA_DIR, then
+ * replays the log into the memtable.
+ */
+KVStore::KVStore(Params *par, int node): par(par), node(node), memSince(-1), wal(NULL), nextSeq(1), flushes(0), flushBytes(0), diskLookups(0), userBytes(0),
+		compactions(0), compactRuns(0), compactRead(0), compactWritten(0), purged(0), dropped(0), compactSeconds(0),
+		compactStop(false), compactBusy(false), compactDone(false), failedFirst(-1), failedLast(-1) {
+	mem = new HashTable();
+	if ( par->WAL || par->LSM ) {
+		mkdir(par->DATA_DIR, 0755);
+	}
+	if ( par->LSM ) {
+		openRuns();
+	}
+	if ( par->WAL ) {
+		openWal();
+	}
+}
+
+/**
+ * Destructor. A merge in progress is abandoned; a finished one that was not
+ * installed is picked up by the next open.
+ */
+KVStore::~KVStore() {
+	if ( par->LSM && par->COMPACT_RUNS > 0 ) {
+		compactStop = true;
+		Compactor::cancel(this);
+	}
+	delete wal;
+	for ( size_t i = 0; i < runs.size(); i++ ) {
+		delete runs[i];
+	}
+	delete mem;
+}
+
+/**
+ * FUNCTION NAME: runPath
+ *
+ * DESCRIPTION: Returns the file name of the run of this node covering flushes
+ * 				firstSeq to lastSeq
+ */
+string KVStore::runPath(long firstSeq, long lastSeq) {
+	char path[128];
+	snprintf(path, sizeof(path), "%s/node%d-%06ld-%06ld.sst", par->DATA_DIR, node, firstSeq, lastSeq);
+	return path;
+}
+
+/**
+ * FUNCTION NAME: openRuns
+ *
+ * DESCRIPTION: Opens the run files of the node in sequence order. Leftovers of an
+ * 				interrupted flush or merge are removed: unfinished files, and inputs
+ * 				of a merge whose output is in place. An output that cannot be opened
+ * 				does not count, its inputs are kept.
+ */
+void KVStore::openRuns() {
+	DIR *dir = opendir(par->DATA_DIR);
+	struct dirent *e;
+	vector< pair<long, long> > seqs;
+	vector<SSTable *> found;
+	int id, n;
+	long first, last;
+	size_t i, j;
+
+	if ( !dir ) {
+		return;
+	}
+	while ( (e = readdir(dir)) != NULL ) {
+		n = 0;
+		if ( sscanf(e->d_name, "node%d-%ld-%ld.sst%n", &id, &first, &last, &n) != 3 || id != node ) {
+			continue;
+		}
+		if ( e->d_name[n] == 0 ) {
+			// ordered by last flush, the widest range first
+			seqs.emplace_back(last, -first);
+		}
+		else {
+			unlink((string(par->DATA_DIR) + "/" + e->d_name).c_str());
+		}
+	}
+	closedir(dir);
+	sort(seqs.begin(), seqs.end());
+	for ( i = 0; i < seqs.size(); i++ ) {
+		found.push_back(new SSTable(runPath(-seqs[i].second, seqs[i].first).c_str(), -seqs[i].second, seqs[i].first));
+	}
+	for ( i = 0; i < seqs.size(); i++ ) {
+		first = -seqs[i].second;
+		last = seqs[i].first;
+		nextSeq = max(nextSeq, last + 1);
+		for ( j = 0; j < seqs.size(); j++ ) {
+			if ( j != i && found[j]->isOpen() && -seqs[j].second <= first && seqs[j].first >= last ) {
+				break;
+			}
+		}
+		if ( j < seqs.size() ) {
+			delete found[i];
+			unlink(runPath(first, last).c_str());
+		}
+		else if ( found[i]->isOpen() ) {
+			runs.push_back(found[i]);
+		}
+		else {
+			delete found[i];
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: openWal
+ *
+ * DESCRIPTION: Opens the write-ahead log of the node and replays it into the memtable
+ */
+void KVStore::openWal() {
+	char path[128];
+
+	snprintf(path, sizeof(path), "%s/node%d.wal", par->DATA_DIR, node);
+	wal = new Wal(path, par->WAL_SYNC);
+	if ( !wal->isOpen() ) {
+		perror(path);
+		delete wal;
+		wal = NULL;
+		return;
+	}
+	wal->replay([this](WalOp op, string_view key, string_view value) {
+		apply(op, key, value);
+	});
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Finds the newest version of key, tombstones included. typed is valid
+ * 				until the store is used again.
+ *
+ * RETURNS:
+ * true if some version was found
+ */
+bool KVStore::lookup(string_view key, string_view &typed) {
+	uint64_t hash;
+
+	if ( mem->find(key, typed) ) {
+		return true;
+	}
+	if ( runs.empty() ) {
+		return false;
+	}
+	hash = BloomFilter::hashOf(key);
+	for ( size_t r = runs.size(); r-- > 0; ) {
+		diskLookups++;
+		if ( runs[r]->get(key, hash, typed) == SST_FOUND ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: apply
+ *
+ * DESCRIPTION: Applies a write to the memtable
+ */
+void KVStore::apply(WalOp op, string_view key, string_view value) {
+	string typed;
+
+	if ( op == WAL_DEL && runs.empty() ) {
+		mem->deleteKey(key);
+		return;
+	}
+	int now = par->getcurrtime();
+
+	typed.reserve(value.size() + 1);
+	if ( op == WAL_PUT ) {
+		typed.push_back(SST_VALUE);
+		typed.append(value);
+	}
+	else {
+		typed.push_back(SST_TOMBSTONE);
+		typed.append((const char *) &now, sizeof(now));
+	}
+	if ( mem->currentSize() == 0 ) {
+		memSince = now;
+	}
+	mem->upsert(key, typed);
+}
+
+/**
+ * FUNCTION NAME: logWrite
+ *
+ * DESCRIPTION: Adds a write to the log. It is made durable by the next commit, or
+ * 				right away without group commit.
+ */
+void KVStore::logWrite(WalOp op, string_view key, string_view value) {
+	if ( !wal ) {
+		return;
+	}
+	wal->append(op, key, value);
+	if ( !par->WAL_GROUP ) {
+		wal->commit();
+	}
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: Inserts the pair
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the key is already stored
+ */
+bool KVStore::create(string_view key, string_view value) {
+	string_view typed;
+
+	if ( lookup(key, typed) && typed[0] == SST_VALUE ) {
+		return false;
+	}
+	apply(WAL_PUT, key, value);
+	logWrite(WAL_PUT, key, value);
+	userBytes += key.size() + value.size();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: read
+ *
+ * DESCRIPTION: Sets value to the value of key, valid until the store is used again
+ *
+ * RETURNS:
+ * true if the key is stored
+ */
+bool KVStore::read(string_view key, string_view &value) {
+	string_view typed;
+
+	if ( !lookup(key, typed) || typed[0] != SST_VALUE ) {
+		return false;
+	}
+	value = typed.substr(1);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: Replaces the value of a stored key
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the key is not stored
+ */
+bool KVStore::update(string_view key, string_view value) {
+	string_view typed;
+
+	if ( !lookup(key, typed) || typed[0] != SST_VALUE ) {
+		return false;
+	}
+	apply(WAL_PUT, key, value);
+	logWrite(WAL_PUT, key, value);
+	userBytes += key.size() + value.size();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: remove
+ *
+ * DESCRIPTION: Deletes a stored key
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the key is not stored
+ */
+bool KVStore::remove(string_view key) {
+	string_view typed;
+
+	if ( !lookup(key, typed) || typed[0] != SST_VALUE ) {
+		return false;
+	}
+	apply(WAL_DEL, key, "");
+	logWrite(WAL_DEL, key, "");
+	userBytes += key.size();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: commit
+ *
+ * DESCRIPTION: Makes the logged writes durable
+ *
+ * RETURNS:
+ * true on SUCCESS, or when there is no log
+ */
+bool KVStore::commit() {
+	return !wal || wal->commit();
+}
+
+/**
+ * FUNCTION NAME: maintain
+ *
+ * DESCRIPTION: Flushes the memtable once it is too big or too old, installs a
+ * 				finished merge and starts the next one
+ */
+void KVStore::maintain(int now) {
+	if ( !par->LSM ) {
+		return;
+	}
+	if ( mem->currentSize() > 0 && (mem->memoryBytes() >= (unsigned long) par->MEMTABLE_BYTES
+			|| (par->MEMTABLE_AGE > 0 && now - memSince >= par->MEMTABLE_AGE)) ) {
+		flush();
+	}
+	if ( par->COMPACT_RUNS > 0 ) {
+		installCompaction();
+		startCompaction(now);
+	}
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Writes the memtable to a new run, then empties it and the log
+ */
+void KVStore::flush() {
+	vector< pair<string_view, string_view> > entries;
+	string path = runPath(nextSeq, nextSeq);
+	SSTableBuilder builder(path.c_str(), par->SST_BLOCK, par->BLOOM_BITS);
+	SSTable *run;
+
+	// the log must hold everything the run will, in case the run is lost
+	if ( !commit() ) {
+		return;
+	}
+	entries.reserve(mem->currentSize());
+	mem->forEach([&](string_view key, string_view typed) {
+		entries.emplace_back(key, typed);
+	});
+	sort(entries.begin(), entries.end());
+	for ( size_t i = 0; i < entries.size(); i++ ) {
+		// nothing older to shadow in the first run
+		if ( runs.empty() && entries[i].second[0] == SST_TOMBSTONE ) {
+			continue;
+		}
+		builder.add(entries[i].first, entries[i].second);
+	}
+	if ( !builder.finish() ) {
+		perror(path.c_str());
+		return;
+	}
+	run = new SSTable(path.c_str(), nextSeq, nextSeq);
+	if ( !run->isOpen() ) {
+		delete run;
+		return;
+	}
+	runs.push_back(run);
+	nextSeq++;
+	flushes++;
+	flushBytes += run->bytes();
+	mem->clear();
+	memSince = -1;
+	if ( wal ) {
+		wal->reset();
+	}
+}
+
+/**
+ * FUNCTION NAME: pickCompaction
+ *
+ * DESCRIPTION: Looks for COMPACT_RUNS adjacent runs within a factor of two in size,
+ * 				newest first. Past three times COMPACT_RUNS runs the newest ones are
+ * 				merged whatever their sizes, to bound the runs a read goes through.
+ *
+ * RETURNS:
+ * true if runs from to to should be merged
+ */
+bool KVStore::pickCompaction(size_t &from, size_t &to) {
+	size_t n = runs.size(), need = par->COMPACT_RUNS;
+	uint64_t lo, hi, b;
+
+	if ( n < need ) {
+		return false;
+	}
+	for ( to = n; to-- > 0; ) {
+		lo = hi = runs[to]->bytes();
+		for ( from = to; from > 0; from-- ) {
+			b = runs[from - 1]->bytes();
+			if ( max(hi, b) > 2 * min(lo, b) ) {
+				break;
+			}
+			lo = min(lo, b);
+			hi = max(hi, b);
+		}
+		if ( to - from + 1 >= need ) {
+			return true;
+		}
+	}
+	if ( n >= 3 * need ) {
+		from = n - need;
+		to = n - 1;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: startCompaction
+ *
+ * DESCRIPTION: Hands the next merge to the Compactor unless one is under way
+ */
+void KVStore::startCompaction(int now) {
+	size_t from, to;
+
+	{
+		lock_guard<mutex> lk(compactLock);
+		if ( compactBusy || !pickCompaction(from, to) ) {
+			return;
+		}
+		if ( runs[from]->getFirstSeq() == failedFirst && runs[to]->getLastSeq() == failedLast ) {
+			return;
+		}
+		job.from = from;
+		job.to = to;
+		job.inputs.clear();
+		for ( size_t i = from; i <= to; i++ ) {
+			job.inputs.push_back(runs[i]->getPath());
+		}
+		job.firstSeq = runs[from]->getFirstSeq();
+		job.lastSeq = runs[to]->getLastSeq();
+		job.bottom = (from == 0);
+		job.now = now;
+		job.output = runPath(job.firstSeq, job.lastSeq);
+		compactBusy = true;
+		compactDone = false;
+	}
+	Compactor::submit(this);
+}
+
+/**
+ * FUNCTION NAME: installCompaction
+ *
+ * DESCRIPTION: Replaces the inputs of a finished merge by its output. Runs are only
+ * 				added after the inputs meanwhile, so they are still at from..to.
+ */
+void KVStore::installCompaction() {
+	SSTable *out;
+
+	lock_guard<mutex> lk(compactLock);
+	if ( !compactBusy || !compactDone ) {
+		return;
+	}
+	compactBusy = false;
+	if ( !job.ok ) {
+		failedFirst = job.firstSeq;
+		failedLast = job.lastSeq;
+		return;
+	}
+	out = new SSTable(job.output.c_str(), job.firstSeq, job.lastSeq);
+	if ( !out->isOpen() ) {
+		delete out;
+		return;
+	}
+	for ( size_t i = job.from; i <= job.to; i++ ) {
+		unlink(runs[i]->getPath().c_str());
+		delete runs[i];
+	}
+	runs.erase(runs.begin() + job.from, runs.begin() + job.to + 1);
+	runs.insert(runs.begin() + job.from, out);
+	compactions++;
+	compactRuns += job.to - job.from + 1;
+	compactRead += job.bytesRead;
+	compactWritten += job.bytesWritten;
+	compactSeconds += job.seconds;
+	purged += job.purged;
+	dropped += job.dropped;
+}
+
+/**
+ * FUNCTION NAME: runCompaction
+ *
+ * DESCRIPTION: Runs the submitted merge, on a Compactor thread
+ */
+void KVStore::runCompaction() {
+	// the node leaves job alone until compactDone
+	compact(job);
+	lock_guard<mutex> lk(compactLock);
+	compactDone = true;
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: k-way merge of the input runs into the output. Among the versions of
+ * 				a key only the one from the newest run is kept. Writing draws from
+ * 				the token bucket of the Compactor, so the merges of all the nodes
+ * 				together do not take the disk from them. The merge fails, and its inputs are kept, if an input
+ * 				cannot be opened or holds a corrupt block: the output would miss
+ * 				their records.
+ */
+void KVStore::compact(compaction_job &job) {
+	vector<SSTable *> inputs;
+	vector<SSTableIterator *> its;
+	// inputs are indexed oldest first, on equal keys the newest pops first
+	auto later = [&its](size_t a, size_t b) {
+		int c = its[a]->key().compare(its[b]->key());
+		return c != 0 ? c > 0 : a < b;
+	};
+	priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+	SSTableBuilder builder(job.output.c_str(), par->SST_BLOCK, par->BLOOM_BITS);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	uint64_t checked = 0;
+	string last;
+	bool any = false, complete = true;
+	int when;
+	size_t i;
+
+	job.ok = false;
+	job.bytesRead = job.bytesWritten = job.purged = job.dropped = 0;
+	for ( i = 0; i < job.inputs.size(); i++ ) {
+		// readers of our own, mapped for a sequential pass
+		inputs.push_back(new SSTable(job.inputs[i].c_str(), 0, 0, true));
+		if ( !inputs[i]->isOpen() ) {
+			complete = false;
+		}
+		its.push_back(new SSTableIterator(inputs[i]));
+		job.bytesRead += inputs[i]->bytes();
+		if ( its[i]->isValid() ) {
+			heap.push(i);
+		}
+	}
+	while ( !heap.empty() && !compactStop ) {
+		i = heap.top();
+		heap.pop();
+		string_view key = its[i]->key(), value = its[i]->value();
+		if ( any && key == last ) {
+			job.dropped++;
+		}
+		else {
+			last.assign(key);
+			any = true;
+			// a tombstone without its time counts as expired
+			when = job.now - par->TOMBSTONE_TTL;
+			if ( value[0] == SST_TOMBSTONE && value.size() >= 1 + sizeof(when) ) {
+				memcpy(&when, value.data() + 1, sizeof(when));
+			}
+			if ( value[0] == SST_TOMBSTONE && job.bottom && job.now - when >= par->TOMBSTONE_TTL ) {
+				job.purged++;
+			}
+			else {
+				builder.add(key, value);
+			}
+		}
+		its[i]->next();
+		if ( its[i]->isValid() ) {
+			heap.push(i);
+		}
+		if ( builder.bytes() - checked >= COMPACT_BURST ) {
+			Compactor::throttle(builder.bytes() - checked);
+			checked = builder.bytes();
+		}
+	}
+	for ( i = 0; i < inputs.size(); i++ ) {
+		if ( its[i]->isCorrupt() ) {
+			complete = false;
+		}
+		delete its[i];
+		delete inputs[i];
+	}
+	if ( compactStop ) {
+		return;
+	}
+	if ( !complete ) {
+		fprintf(stderr, "%s: merge abandoned, an input is missing or corrupt\n", job.output.c_str());
+		return;
+	}
+	job.ok = builder.finish();
+	job.bytesWritten = builder.bytes();
+	job.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Returns the number of live keys
+ */
+unsigned long KVStore::size() {
+	unsigned long n = 0;
+
+	forEach([&](string_view key, string_view value) {
+		n++;
+	});
+	return n;
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the bytes held in memory, memtable and run indexes
+ */
+unsigned long KVStore::memoryBytes() {
+	unsigned long n = mem->memoryBytes();
+	for ( size_t r = 0; r < runs.size(); r++ ) {
+		n += runs[r]->memoryBytes();
+	}
+	return n;
+}
+
+/**
+ * FUNCTION NAME: logStats
+ *
+ * DESCRIPTION: Writes the storage statistics to the stats log
+ */
+void KVStore::logStats(Log *log, Address *addr) {
+	unsigned long runBytes = 0;
+	long blockReads = 0, filterSkips = 0, falsePositives = 0;
+
+	if ( wal ) {
+		log->LOG(addr, "#STATSLOG# wal records %ld commits %ld bytes %ld", wal->getRecords(), wal->getCommits(), wal->getBytes());
+	}
+	// short entries should stay in their slot, the inline count falls behind the keys when they spill
+	if ( mem->currentSize() > 0 ) {
+		log->LOG(addr, "#STATSLOG# memtable keys %lu inline %lu bytes per key %.1f", mem->currentSize(), mem->inlineKeys(),
+				(double) mem->memoryBytes() / mem->currentSize());
+	}
+	if ( par->LSM ) {
+		for ( size_t r = 0; r < runs.size(); r++ ) {
+			runBytes += runs[r]->bytes();
+			blockReads += runs[r]->getBlockReads();
+			filterSkips += runs[r]->getFilterSkips();
+			falsePositives += runs[r]->getFalsePositives();
+		}
+		log->LOG(addr, "#STATSLOG# lsm memtable keys %lu bytes %lu runs %d run bytes %lu flushes %ld flushed bytes %ld disk lookups %ld block reads %ld",
+				mem->currentSize(), mem->memoryBytes(), (int) runs.size(), runBytes, flushes, flushBytes, diskLookups, blockReads);
+		log->LOG(addr, "#STATSLOG# bloom bits per key %d skipped lookups %ld false positives %ld", par->BLOOM_BITS, filterSkips, falsePositives);
+		// bytes written to disk per byte of keys and values written by clients
+		log->LOG(addr, "#STATSLOG# compaction merges %ld runs merged %ld bytes read %ld written %ld bytes per second %.0f tombstones purged %ld versions dropped %ld write amplification %.2f",
+				compactions, compactRuns, compactRead, compactWritten, compactSeconds > 0 ? compactWritten / compactSeconds : 0.0, purged, dropped,
+				userBytes > 0 ? (double) ((wal ? wal->getBytes() : 0) + flushBytes + compactWritten) / userBytes : 0.0);
+	}
+}
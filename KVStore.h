@@ -0,0 +1,147 @@
+/**********************************
+ * FILE NAME: KVStore.h
+ *
+ * DESCRIPTION: Storage engine of the replicas held by a node
+ **********************************/
+
+#ifndef KVSTORE_H_
+#define KVSTORE_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Log.h"
+#include "HashTable.h"
+#include "Wal.h"
+#include "SSTable.h"
+#include "Compactor.h"
+#include <mutex>
+#include <atomic>
+
+/**
+ * STRUCT NAME: compaction_job
+ *
+ * DESCRIPTION: Merge of the runs from..to handed to the compaction threads, and its
+ * 				outcome
+ */
+typedef struct compaction_job {
+	size_t from, to;
+	vector<string> inputs;
+	long firstSeq, lastSeq;
+	// the oldest run is an input, tombstones have nothing left to shadow
+	bool bottom;
+	int now;
+	// outcome
+	bool ok;
+	string output;
+	long bytesRead, bytesWritten, purged, dropped;
+	double seconds;
+} compaction_job;
+
+/**
+ * CLASS NAME: KVStore
+ *
+ * DESCRIPTION: Log-structured merge store. Writes go to the write-ahead log, when
+ * 				enabled, and to the memtable, a HashTable. With LSM enabled the
+ * 				memtable is frozen once it passes MEMTABLE_BYTES or MEMTABLE_AGE time
+ * 				units, written to a new sorted table file (run) and emptied, along
+ * 				with the log. Reads look in the memtable, then in the runs from the
+ * 				newest to the oldest; the Bloom filter of a run answers most misses
+ * 				without reading it.
+ *
+ * 				Values are stored with a leading type byte, SST_VALUE or
+ * 				SST_TOMBSTONE. A delete leaves a tombstone, followed by the time of
+ * 				the delete, when older runs may hold the key, otherwise it erases it
+ * 				from the memtable.
+ *
+ * 				The Compactor threads merge runs of similar sizes (size-tiered
+ * 				compaction): a k-way merge keeps the newest version of every key and
+ * 				drops the tombstones older than TOMBSTONE_TTL once the merge reaches
+ * 				the oldest run. The output is named after the range of flushes it
+ * 				covers, so runs left over by a crash are found covered and removed
+ * 				on restart. The merge only reads its inputs and writes the output;
+ * 				the node installs the result at its next maintain.
+ */
+class KVStore {
+private:
+	Params *par;
+	int node;
+	HashTable *mem;
+	// time of the first write to the memtable, -1 while it is empty
+	int memSince;
+	Wal *wal;
+	// runs, oldest first
+	vector<SSTable *> runs;
+	long nextSeq;
+	// statistics
+	long flushes, flushBytes, diskLookups, userBytes;
+	long compactions, compactRuns, compactRead, compactWritten, purged, dropped;
+	double compactSeconds;
+	// merge handed to the Compactor
+	mutex compactLock;
+	atomic<bool> compactStop;
+	// a job is handed to the Compactor, finished
+	bool compactBusy, compactDone;
+	compaction_job job;
+	// sequence range of the last merge that failed, not tried again as it is
+	long failedFirst, failedLast;
+	string runPath(long firstSeq, long lastSeq);
+	void openWal();
+	void openRuns();
+	bool pickCompaction(size_t &from, size_t &to);
+	void startCompaction(int now);
+	void installCompaction();
+	void runCompaction();
+	void compact(compaction_job &job);
+	friend class Compactor;
+	bool lookup(string_view key, string_view &typed);
+	void apply(WalOp op, string_view key, string_view value);
+	void logWrite(WalOp op, string_view key, string_view value);
+	void flush();
+public:
+	KVStore(Params *par, int node);
+	virtual ~KVStore();
+	bool create(string_view key, string_view value);
+	bool read(string_view key, string_view &value);
+	bool update(string_view key, string_view value);
+	bool remove(string_view key);
+	bool logging() { return wal != NULL; }
+	bool commit();
+	void maintain(int now);
+	unsigned long size();
+	unsigned long memoryBytes();
+	void logStats(Log *log, Address *addr);
+
+	/**
+	 * FUNCTION NAME: forEach
+	 *
+	 * DESCRIPTION: Calls f(key, value) for every live key, newest version only. f must
+	 * 				not use the store.
+	 */
+	template <class F>
+	void forEach(F f) {
+		HashTable seen;
+		bool shadow = !runs.empty();
+
+		mem->forEach([&](string_view key, string_view typed) {
+			if ( shadow ) {
+				seen.create(key, "");
+			}
+			if ( typed[0] == SST_VALUE ) {
+				f(key, typed.substr(1));
+			}
+		});
+		for ( size_t r = runs.size(); r-- > 0; ) {
+			runs[r]->forEach([&](string_view key, string_view typed) {
+				if ( (r > 0) ? !seen.create(key, "") : seen.count(key) > 0 ) {
+					// shadowed by a newer version
+					return;
+				}
+				if ( typed[0] == SST_VALUE ) {
+					f(key, typed.substr(1));
+				}
+			});
+		}
+	}
+};
+
+#endif /* KVSTORE_H_ */
@@ -6,6 +6,11 @@
 
 #include "Log.h"
 
+static FILE *fp;
+static FILE *fp2;
+static int numwrites;
+static int dbg_opened=0;
+
 /**
  * Constructor
  */
@@ -20,6 +25,7 @@ Log::Log(Params *p) {
 Log::Log(const Log &anotherLog) {
 	this->par = anotherLog.par;
 	this->firstTime = anotherLog.firstTime;
+	this->captures.resize(anotherLog.captures.size());
 }
 
 /**
@@ -28,6 +34,7 @@ Log::Log(const Log &anotherLog) {
 Log& Log::operator = (const Log& anotherLog) {
 	this->par = anotherLog.par;
 	this->firstTime = anotherLog.firstTime;
+	this->captures.resize(anotherLog.captures.size());
 	return *this;
 }
 
@@ -40,18 +47,16 @@ Log::~Log() {}
  * FUNCTION NAME: LOG
  *
  * DESCRIPTION: Print out to file dbg.log, along with Address of node.
+ * 				Lines logged by a node run by the tick engine are kept by the worker
+ * 				until the end of the phase, see flush.
  */
 void Log::LOG(Address *addr, const char * str, ...) {
 
-	static FILE *fp;
-	static FILE *fp2;
 	va_list vararglist;
-	static char buffer[30000];
-	static int numwrites;
-	static char stdstring[30];
-	static char stdstring2[40];
-	static char stdstring3[40]; 
-	static int dbg_opened=0;
+	static thread_local char buffer[30000];
+	static thread_local char stdstring[30];
+	char stdstring2[40];
+	char stdstring3[40];
 
 	if(dbg_opened != 639){
 		numwrites=0;
@@ -76,6 +81,20 @@ void Log::LOG(Address *addr, const char * str, ...) {
 	vsprintf(buffer, str, vararglist);
 	va_end(vararglist);
 
+	if ( ThreadPool::worker >= 0 ) {
+		log_line l = { ThreadPool::taskKey, stdstring, buffer };
+		captures[ThreadPool::worker].push_back(l);
+		return;
+	}
+	write(stdstring, buffer);
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Writes a formatted line to dbg.log, or to stats.log for #STATSLOG# lines
+ */
+void Log::write(const char *stdstring, const char *buffer) {
 	if (!firstTime) {
 		int magicNumber = 0;
 		string magic = MAGIC_NUMBER;
@@ -108,13 +127,36 @@ void Log::LOG(Address *addr, const char * str, ...) {
 
 }
 
+/**
+ * FUNCTION NAME: workers
+ *
+ * DESCRIPTION: Sets up one line buffer per worker of the tick engine
+ */
+void Log::workers(int n) {
+	captures.resize(n);
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Writes the lines logged during a parallel phase, in the order the
+ * 				nodes would have logged them one after the other
+ */
+void Log::flush() {
+	vector<log_line> merged;
+	ThreadPool::merge(captures, merged);
+	for ( size_t i = 0; i < merged.size(); i++ ) {
+		write(merged[i].addr.c_str(), merged[i].text.c_str());
+	}
+}
+
 /**
  * FUNCTION NAME: logNodeAdd
  *
  * DESCRIPTION: To Log a node add
  */
 void Log::logNodeAdd(Address *thisNode, Address *addedAddr) {
-	static char stdstring[100];
+	char stdstring[100];
 	sprintf(stdstring, "Node %d.%d.%d.%d:%d joined at time %d", addedAddr->addr[0], addedAddr->addr[1], addedAddr->addr[2], addedAddr->addr[3], *(short *)&addedAddr->addr[4], par->getcurrtime());
     LOG(thisNode, stdstring);
 }
@@ -125,7 +167,7 @@ void Log::logNodeAdd(Address *thisNode, Address *addedAddr) {
  * DESCRIPTION: To log a node remove
  */
 void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
-	static char stdstring[30];
+	char stdstring[100];
 	sprintf(stdstring, "Node %d.%d.%d.%d:%d removed at time %d", removedAddr->addr[0], removedAddr->addr[1], removedAddr->addr[2], removedAddr->addr[3], *(short *)&removedAddr->addr[4], par->getcurrtime());
     LOG(thisNode, stdstring);
 }
@@ -135,15 +177,11 @@ void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
  *
  * DESCRTION: Call this function after successfully create a key value pair
  */
-void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: create success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value){
+	char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: create success at time %d, transID=%d, key=%.*s, value=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data(), (int) value.size(), value.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -151,15 +189,11 @@ void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function after successfully reading a key
  */
-void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-    static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: read success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value){
+    char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: read success at time %d, transID=%d, key=%.*s, value=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data(), (int) value.size(), value.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -167,15 +201,11 @@ void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, str
  *
  * DESCRIPTION: Call this function after successfully updating a key
  */
-void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: update success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
-    LOG(address, stdstring);
+void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue){
+    char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: update success at time %d, transID=%d, key=%.*s, value=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data(), (int) newValue.size(), newValue.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -183,15 +213,11 @@ void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function after successfully deleting a key
  */
-void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: delete success at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, string_view key){
+    char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: delete success at time %d, transID=%d, key=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -199,15 +225,11 @@ void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function if CREATE failed
  */
-void Log::logCreateFail(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: create fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+void Log::logCreateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view value){
+	char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: create fail at time %d, transID=%d, key=%.*s, value=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data(), (int) value.size(), value.data());
+    LOG(address, "%s", stdstring);
 }
 
 
@@ -216,15 +238,11 @@ void Log::logCreateFail(Address * address, bool isCoordinator, int transID, stri
  *
  * DESCRIPTION: Call this function if READ failed
  */
-void Log::logReadFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: read fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+void Log::logReadFail(Address * address, bool isCoordinator, int transID, string_view key){
+    char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: read fail at time %d, transID=%d, key=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -232,15 +250,11 @@ void Log::logReadFail(Address * address, bool isCoordinator, int transID, string
  *
  * DESCRIPTION: Call this function if UPDATE failed
  */
-void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: update fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
-    LOG(address, stdstring);
+void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue){
+    char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: update fail at time %d, transID=%d, key=%.*s, value=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data(), (int) newValue.size(), newValue.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -248,13 +262,9 @@ void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, stri
  *
  * DESCRIPTION: Call this function if DELETE failed
  */
-void Log::logDeleteFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
-	string str;
-	if (isCoordinator)
-		str = "coordinator";
-	else
-		str = "server";
-	sprintf(stdstring, "%s: delete fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+void Log::logDeleteFail(Address * address, bool isCoordinator, int transID, string_view key){
+    char stdstring[100];
+	const char *str = isCoordinator ? "coordinator" : "server";
+	snprintf(stdstring, sizeof(stdstring), "%s: delete fail at time %d, transID=%d, key=%.*s", str, par->getcurrtime(), transID, (int) key.size(), key.data());
+    LOG(address, "%s", stdstring);
 }
@@ -10,6 +10,7 @@
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "ThreadPool.h"
 
 /*
  * Macros
@@ -20,6 +21,17 @@
 #define DBG_LOG "dbg.log"
 #define STATS_LOG "stats.log"
 
+/**
+ * STRUCT NAME: log_line
+ *
+ * DESCRIPTION: Line logged during a parallel phase, seq orders the merge
+ */
+typedef struct log_line {
+	int seq;
+	string addr;
+	string text;
+} log_line;
+
 /**
  * CLASS NAME: Log
  *
@@ -29,24 +41,29 @@ class Log{
 private:
 	Params *par;
 	bool firstTime;
+	// lines logged by the nodes run by each worker during a parallel phase
+	vector< vector<log_line> > captures;
+	void write(const char *stdstring, const char *buffer);
 public:
 	Log(Params *p);
 	Log(const Log &anotherLog);
 	Log& operator = (const Log &anotherLog);
 	virtual ~Log();
 	void LOG(Address *, const char * str, ...);
+	void workers(int n);
+	void flush();
 	void logNodeAdd(Address *, Address *);
 	void logNodeRemove(Address *, Address *);
 	// success
-	void logCreateSuccess(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logReadSuccess(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logUpdateSuccess(Address * address, bool isCoordinator, int transID, string key, string newValue);
-	void logDeleteSuccess(Address * address, bool isCoordinator, int transID, string key);
+	void logCreateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value);
+	void logReadSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value);
+	void logUpdateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue);
+	void logDeleteSuccess(Address * address, bool isCoordinator, int transID, string_view key);
 	// fail
-	void logCreateFail(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logReadFail(Address * address, bool isCoordinator, int transID, string key);
-	void logUpdateFail(Address * address, bool isCoordinator, int transID, string key, string newValue);
-	void logDeleteFail(Address * address, bool isCoordinator, int transID, string key);
+	void logCreateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view value);
+	void logReadFail(Address * address, bool isCoordinator, int transID, string_view key);
+	void logUpdateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue);
+	void logDeleteFail(Address * address, bool isCoordinator, int transID, string_view key);
 };
 
 #endif /* _LOG_H_ */
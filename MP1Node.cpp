@@ -121,7 +121,7 @@ int MP1Node::initThisNode(Address *joinaddr) {
  */
 int MP1Node::introduceSelfToGroup(Address *joinaddr) {
 #ifdef DEBUGLOG
-    static char s[1024];
+    char s[1024];
 #endif
 
     if ( 0 == memcmp((char *)&(memberNode->addr.addr), (char *)&(joinaddr->addr), sizeof(memberNode->addr.addr))) {
@@ -198,13 +198,13 @@ void MP1Node::nodeLoop() {
  * DESCRIPTION: Check messages in the queue and call the respective message handler
  */
 void MP1Node::checkMessages() {
-    void *ptr;
 		MsgTypes r;
     // Pop waiting messages from memberNode's mp1q
     while ( !memberNode->mp1q.empty() ) {
-    	ptr = memberNode->mp1q.front().elt;
+    	// msg keeps the buffer alive until it goes out of scope
+    	q_elt msg = memberNode->mp1q.front();
     	memberNode->mp1q.pop();
-			if((r = op->decode((char *) ptr)) == LEAVE)
+			if((r = op->decode((char *) msg.elt)) == LEAVE)
 			  break;
 			if(r == JOINREP)
 			  memberNode->inGroup = true;
@@ -232,26 +232,27 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
  * 				Propagate your membership list
  */
 void MP1Node::nodeLoopOps() {
-	vector<nodeEntry *> pl;
-	vector<nodeEntry *>::iterator it;
+	vector<int>::iterator it;
+	nodeEntry *p;
 	Statuses st;
 	char *iAddr;
-	int d;
+	int d = 0;
 
   op->statusEval();
 
   op->incrmyhb();
-  op->initPingList();
+  op->initPingList(par->PING_FANOUT);
 	op->encode(PGYPING);
-  pl = op->getpingList();
+  vector<int> &pl = op->getpingList();
   for(it=pl.begin(); it != pl.end(); it++) {
-		st = (*it)->getstatus();
+		p = op->peer(*it);
+		st = p->getstatus();
 		if(st == DEAD) continue;
-		op->send((*it)->getaddr());
+		op->send(p->getaddr());
 		if(st == SUSPECT) {
 			if(d == 0) {
 				d = 3;
-				iAddr = (*it)->getaddr();
+				iAddr = p->getaddr();
 				op->encode(IPGYPING, iAddr);
 			} else
 			  d--;
@@ -318,35 +319,60 @@ void MP1Node::printAddress(Address *addr)
 
 /* ------------------------- memberList functions ------------------------------------- */
 
+/* memberList is an index view of the peer table: every peer (or me) knows
+   its position in it, entries are removed by moving the last one in their place */
+nodeEntry *Operation::_memberList_owner(char *addr) {
+	int i;
+	if(!memcmp(addr, me->getaddr(), ADDRSZ)) return me;
+	i = peers.find(addr);
+	return (i < 0) ? NULL : peers.at(i);
+}
+
 vector<MemberListEntry>::iterator Operation::_memberList_add(char *addr, long hb, long ts) {
 	int id;
 	short port;
-  vector<MemberListEntry>::iterator p;
+	nodeEntry *o = _memberList_owner(addr);
 
+	if(o && o->getmlpos() >= 0) return memberNode->memberList.begin() + o->getmlpos();
 	memcpy(&id, &addr[0], sizeof(int));
 	memcpy(&port, &addr[4], sizeof(short));
 	memberNode->memberList.emplace_back(id, port, hb, ts);
-	p = memberNode->memberList.end()-1;
-  return p;
+	if(o) o->setmlpos(memberNode->memberList.size()-1);
+	_ringEvent(RING_JOIN, addr);
+  return memberNode->memberList.end()-1;
 }
 
 vector<MemberListEntry>::iterator Operation::_memberList_search(char *addr) {
-	int id;
-	short port;
-  vector<MemberListEntry>::iterator p;
-
-	memcpy(&id, &addr[0], sizeof(int));
-	memcpy(&port, &addr[4], sizeof(short));
-	for(p = memberNode->memberList.begin(); p != memberNode->memberList.end(); p++)
-		if(p->id == id && p->port == port) break;
-  return p;
+	nodeEntry *o = _memberList_owner(addr);
+	if(!o || o->getmlpos() < 0) return memberNode->memberList.end();
+	return memberNode->memberList.begin() + o->getmlpos();
 }
 
 vector<MemberListEntry>::iterator Operation::_memberList_del(char *addr) {
-  vector<MemberListEntry>::iterator p = _memberList_search(addr);
-  if(p != memberNode->memberList.end())
-	  p = memberNode->memberList.erase(p);
-  return p;
+	vector<MemberListEntry> &ml = memberNode->memberList;
+	nodeEntry *o = _memberList_owner(addr), *m;
+	char maddr[ADDRSZ];
+	int pos;
+
+	if(!o || (pos = o->getmlpos()) < 0) return ml.end();
+	if(pos != (int) ml.size()-1) {
+		ml[pos] = ml.back();
+		memcpy(&maddr[0], &ml[pos].id, sizeof(int));
+		memcpy(&maddr[4], &ml[pos].port, sizeof(short));
+		if((m = _memberList_owner(maddr))) m->setmlpos(pos);
+	}
+	ml.pop_back();
+	o->setmlpos(-1);
+	_ringEvent(RING_LEAVE, addr);
+  return ml.begin() + pos;
+}
+
+void Operation::_ringEvent(RingEventType type, char *addr) {
+	ring_event e;
+	e.type = type;
+	if(addr) memcpy(e.addr.addr, addr, sizeof(e.addr.addr));
+	else e.addr.init();
+	memberNode->ringEvents.push_back(e);
 }
 
 /* ------------------------- end of memberList functions ------------------------------ */
@@ -359,72 +385,10 @@ nodeEntry::nodeEntry(char *addr, long hb, long myhb, Statuses status, Params *pa
   this->hb = hb;
   this->myhb = myhb;
 	tstamp = par->getcurrtime();
+  this->timerAt = -1;
   this->status = status;
-  this->prev = this->next = NULL;
-}
-
-nodeEntry *nodeEntry::add(nodeEntry *i) {
-  if(*i == *this) { cout << "dup!\n"; return this; } // consider update
-  if(!this->prev && *i < *this) {  // first
-    i->next = this;
-    i->prev = NULL;
-    this->prev = i;
-    return i;
-  }
-  if(!this->next && *i > *this) {  // last
-    i->prev = this;
-    i->next = NULL;
-    this->next = i;
-    return i;
-  }
-  if(*i < *this) {
-    if(*i > *this->prev) {
-      i->next = this;
-      i->prev = this->prev;
-      this->prev->next = i;
-      this->prev = i;
-      return i;
-    } else {
-      return this->prev->add(i);
-    }
-  } else if(*i > *this) {
-    if(*i < *this->next) {
-      i->prev = this;
-      i->next = this->next;
-      this->next->prev = i;
-      this->next = i;
-      return i;
-    } else {
-      return this->next->add(i);
-    }
-  }
-  cout << "skipped" << endl;
-  return this;
-}
-
-nodeEntry *nodeEntry::find(char *addr) {
-  int i = memcmp(this->addr, addr, sizeof(this->addr));
-  if(!i) return this;
-  if(i > 0) {
-    if(this->prev) {
-      if(memcmp(this->prev->addr, addr, sizeof(this->addr)) < 0) return NULL;
-      else return this->prev->find(addr);
-    } else return NULL;
-  }
-  if(i < 0) {
-    if(this->next) {
-      if(memcmp(this->next->addr, addr, sizeof(this->addr)) > 0) return NULL;
-      else return this->next->find(addr);
-    } else return NULL;
-  }
-  return NULL;
-}
-
-nodeEntry *nodeEntry::unlink() {
-  nodeEntry *r = NULL;
-  if(this->prev) { this->prev->next = this->next; r = this->next; }
-  if(this->next) { this->next->prev = this->prev; r = this->prev; }
-  return r;
+  this->prev = this->next = this->mlPos = this->pingAt = -1;
+  this->gossiped = false;
 }
 
 char *nodeEntry::encode(char **b) {
@@ -446,7 +410,9 @@ char *nodeEntry::decode(char **b, Params *par) {
   *b += sizeof(this->status);
 	this->par = par;
   this->tstamp = par->getcurrtime();
-	this->prev = this->next = NULL;
+  this->timerAt = -1;
+	this->prev = this->next = this->mlPos = this->pingAt = -1;
+	this->gossiped = false;
   return *b;
 }
 
@@ -467,9 +433,13 @@ nodeEntry& nodeEntry::operator =(const nodeEntry &anotherNodeEntry) {
   this->myhb = anotherNodeEntry.myhb;
   this->status = anotherNodeEntry.status;
   this->tstamp = anotherNodeEntry.tstamp;
+  this->timerAt = anotherNodeEntry.timerAt;
 	this->par = anotherNodeEntry.par;
   this->prev = anotherNodeEntry.prev;
   this->next = anotherNodeEntry.next;
+  this->mlPos = anotherNodeEntry.mlPos;
+  this->pingAt = anotherNodeEntry.pingAt;
+  this->gossiped = anotherNodeEntry.gossiped;
   return *this;
 }
 
@@ -487,13 +457,57 @@ bool nodeEntry::operator >(const nodeEntry& anotherNodeEntry) {
 
 /* ----------------------- end node.cpp ---------------------------- */
 
+/* ------------------------- peertable.cpp ------------------------------ */
+
+size_t PeerTable::home(const char *addr) {
+  unsigned long long k = 0;
+  memcpy(&k, addr, ADDRSZ);
+  return (size_t) ((k * 11400714819323198485ull) >> 40) & mask;
+}
+
+void PeerTable::grow() {
+  slots.assign(slots.size() * 2, -1);
+  mask = slots.size() - 1;
+  for(int i = 0; i < (int) peers.size(); i++) {
+    size_t j = home(peers[i].getaddr());
+    while(slots[j] >= 0) j = (j + 1) & mask;
+    slots[j] = i;
+  }
+}
+
+int PeerTable::find(char *addr) {
+  for(size_t j = home(addr); slots[j] >= 0; j = (j + 1) & mask)
+    if(!memcmp(peers[slots[j]].getaddr(), addr, ADDRSZ)) return slots[j];
+  return -1;
+}
+
+/* Copies n at the end of the table, returns its index */
+int PeerTable::add(nodeEntry &n) {
+  int i = find(n.getaddr());
+  size_t j;
+  if(i >= 0) return i;
+  if((peers.size() + 1) * 2 > slots.size()) grow();
+  i = peers.size();
+  peers.push_back(n);
+  peers[i].setPrev(last);
+  peers[i].setNext(-1);
+  if(last >= 0) peers[last].setNext(i);
+  else first = i;
+  last = i;
+  for(j = home(n.getaddr()); slots[j] >= 0; j = (j + 1) & mask);
+  slots[j] = i;
+  return i;
+}
+
+/* ----------------------- end peertable.cpp ---------------------------- */
+
 /* ------------------------- op.cpp ------------------------------ */
 
-Operation::Operation(Member *memberNode, Statuses status, EmulNet *emulNet, Params *par, Log *log) {
+Operation::Operation(Member *memberNode, Statuses status, EmulNet *emulNet, Params *par, Log *log):
+  gossipPos(-1), pingPos(0), pingRng(par->rng(*(int *)(memberNode->addr.addr), RNG_PING)), fdTimers(par->getcurrtime()) {
   this->me = new nodeEntry(memberNode->addr.addr, memberNode->heartbeat, memberNode->heartbeat, status, par);
 	this->memberNode = memberNode;
   this->recsz = sizeof(memberNode->addr.addr)+sizeof(memberNode->heartbeat)+sizeof(status);
-  this->peersList = this->first = this->last = NULL;
 	this->emulNet = emulNet;
 	this->par = par;
 	this->log = log;
@@ -501,37 +515,100 @@ Operation::Operation(Member *memberNode, Statuses status, EmulNet *emulNet, Para
 	this->to = new Address;
 	this->me->getAddress(this->from);
 	this->memberNode->memberList.clear();
+	_ringEvent(RING_RESET, NULL);
 	this->memberNode->myPos = _memberList_add(memberNode->addr.addr, memberNode->heartbeat, 0);
 }
 
-void Operation::destroyPeersList(nodeEntry *n) {
-  nodeEntry *x;
-  while((x = n->getNext())) {
-    delete n;
-    n = x;
-  }
-}
-
 Operation::~Operation() {
-  destroyPeersList(first);
   delete me;
   pingList.clear();
+  pingOrder.clear();
   gossipList.clear();
 	if(from) delete from;
 	if(to) delete to;
 	memberNode->memberList.resize(0);
+	_ringEvent(RING_RESET, NULL);
 }
 
-void Operation::initPingList() {
-  nodeEntry *n = this->first;
-  random_device rd;
+/* ----------------------------------------
+   Next n peers of the ping permutation,
+   n <= 0 means a whole round
+   ----------------------------------------- */
+void Operation::initPingList(int n) {
   pingList.clear();
-  while(n) {
-    pingList.push_back(n);
-    n = n->getNext();
+  if(n <= 0) n = pingOrder.size();
+  while((int) pingList.size() < n && pingList.size() < pingOrder.size()) {
+    if(pingPos >= pingOrder.size()) {   // round completed
+      shuffle(pingOrder.begin(), pingOrder.end(), pingRng);
+      for(size_t p = 0; p < pingOrder.size(); p++) setPingAt(p, pingOrder[p]);
+      pingPos = 0;
+    }
+    nodeEntry *x = peers.at(pingOrder[pingPos]);
+    if(x->getstatus() == DEAD) {   // swap-remove, the last peer is not pinged yet either
+      x->setpingpos(-1);
+      if(pingPos + 1 < pingOrder.size()) setPingAt(pingPos, pingOrder.back());
+      pingOrder.pop_back();
+      continue;
+    }
+    pingList.push_back(pingOrder[pingPos++]);
+  }
+}
+
+/* ----------------------------------------
+   Put peer i at position p of the ping
+   permutation
+   ----------------------------------------- */
+void Operation::setPingAt(size_t p, int i) {
+  pingOrder[p] = i;
+  peers.at(i)->setpingpos((int) p);
+}
+
+/* ----------------------------------------
+   New peer, it goes at a random position
+   among the peers still to ping this round,
+   the peer it displaces goes last
+   ----------------------------------------- */
+void Operation::addPingTarget(int i) {
+  size_t p = pingPos + pingRng.below((int) (pingOrder.size() - pingPos + 1));
+  pingOrder.push_back(i);
+  setPingAt(pingOrder.size() - 1, pingOrder[p]);
+  setPingAt(p, i);
+}
+
+/* ----------------------------------------
+   Failure detection timer of a peer,
+   due TFAIL after its last heartbeat
+   ----------------------------------------- */
+void Operation::armTimer(int i) {
+  nodeEntry *n = peers.at(i);
+  if(n->gettimer() >= 0) return;   // already pending, it is moved on expiry
+  n->settimer(n->gettstamp() + TFAIL);
+  fdTimers.schedule(i, n->gettimer());
+}
+
+void Operation::expireTimer(int i) {
+	Address a, b;
+  nodeEntry *n = peers.at(i);
+  n->settimer(-1);
+  if(n->getstatus() == DEAD) return;
+  if(n->getElapsedt() < TFAIL) {   // heartbeat since the timer was set
+    armTimer(i);
+    return;
+  }
+  if(n->getElapsedt() >= TREMOVE) {
+    n->setstatus(DEAD);
+    _memberList_del(n->getAddress(&b)->addr);
+    log->logNodeRemove(me->getAddress(&a), &b);
+  } else {
+    if(n->setstatus(SUSPECT)) _ringEvent(RING_SUSPECT, n->getaddr());
+    n->settimer(n->gettstamp() + TREMOVE);
+    fdTimers.schedule(i, n->gettimer());
+  }
+  n->setmyhb(me->getmyhb());
+  if(!n->isgossiped()) {
+    n->setgossiped(true);
+    gossipList.insert(gossipList.begin(), i);
   }
-  mt19937 generator(rd());
-  shuffle(pingList.begin(), pingList.end(), generator);
 }
 
 char *Operation::getHeader(MsgTypes t, char *iAddr) {
@@ -546,106 +623,115 @@ char *Operation::getHeader(MsgTypes t, char *iAddr) {
 }
 
 int Operation::updtGossipLst(int n) {
-  nodeEntry *p, *b;
-  vector<nodeEntry *>::iterator it;
-  int i;
-
-  for(it=gossipList.begin() ; it != gossipList.end(); )
-    if((*it)->getElapsedt() > TGOSSIPENTRY) it = gossipList.erase(it);
-    else it++;
-  if(!peersList) return 0;
-  p = b = peersList;
-  if((i = gossipList.size()) > n) {
-    gossipList.erase(gossipList.begin()+n, gossipList.end());
-    peersList = gossipList.back();
-    i = n;
-  } else {
-    while(i<n) {
-      if(p->isLast()) p = first; // reached the end
-      else p = p->getNext();
-      if(p == b) break;           // whole round
-      if(find(gossipList.begin(), gossipList.end(), p)==gossipList.end()) {
-        gossipList.push_back(p);
-        i++;
-      }
+  int p, b;
+  size_t i, j;
+
+  for(i = j = 0; i < gossipList.size(); i++)
+    if(peers.at(gossipList[i])->getElapsedt() > TGOSSIPENTRY) peers.at(gossipList[i])->setgossiped(false);
+    else gossipList[j++] = gossipList[i];
+  gossipList.resize(j);
+  if(!peers.size()) return 0;
+  if(gossipPos < 0) gossipPos = peers.getFirst();
+  p = b = gossipPos;
+  if((int) gossipList.size() > n) {
+    for(i = n; i < gossipList.size(); i++) peers.at(gossipList[i])->setgossiped(false);
+    gossipList.resize(n);
+    gossipPos = gossipList.back();
+    return n;
+  }
+  while((int) gossipList.size() < n) {
+    if(peers.at(p)->isLast()) p = peers.getFirst(); // reached the end
+    else p = peers.at(p)->getNext();
+    if(p == b) break;           // whole round
+    if(!peers.at(p)->isgossiped()) {
+      peers.at(p)->setgossiped(true);
+      gossipList.push_back(p);
     }
-    peersList = p;
   }
-
-  return i;
+  gossipPos = p;
+  return gossipList.size();
 }
 
 char *Operation::addPayload(char **b) {
   int n = updtGossipLst(((MAXMSGSZ - sizeof(n) - (*b - msgBff)) / recsz));
-  vector<nodeEntry *>::iterator it;
+  vector<int>::iterator it;
   memcpy(*b, &n, sizeof(n)); *b += sizeof(n);
   for(it=gossipList.begin() ; it != gossipList.end(); it++)
-    (*it)->encode(b);
+    peers.at(*it)->encode(b);
   return *b;
 }
 
 void Operation::updatePeersList(nodeEntry *n) {
-  nodeEntry *x = NULL;
+  nodeEntry *x;
+  int i;
   bool gssp = FALSE;
+  Statuses was;
 	Address a, b;
-  if(peersList) x = peersList->find(n->getaddr());
-  if((gssp = !x)) {
-    x = new nodeEntry();
-    *x = *n;
+  i = peers.find(n->getaddr());
+  if((gssp = (i < 0))) {
+    i = peers.add(*n);
+    x = peers.at(i);
     x->setmyhb(me->getmyhb());
-    if(peersList) peersList->add(x);
-    else peersList = x;
-    if(x->isFirst()) first = x;
-    if(x->isLast()) last = x;
 		_memberList_add(n->getAddress(&b)->addr, n->gethb(), (long) n->gettstamp());
 		log->logNodeAdd(me->getAddress(&a), &b);
+		addPingTarget(i);
+		armTimer(i);
   } else {
+    x = peers.at(i);
     if((gssp = x->sethb(n->gethb()))) {
-			x->setstatus(n->getstatus());
+			if(x->getstatus() == DEAD && n->getstatus() != DEAD && x->getpingpos() < 0)
+				addPingTarget(i);
+			was = x->getstatus();
+			if(x->setstatus(n->getstatus())) {
+				if(n->getstatus() == SUSPECT) _ringEvent(RING_SUSPECT, x->getaddr());
+				else if(was == SUSPECT && n->getstatus() == ALIVE) _ringEvent(RING_ALIVE, x->getaddr());
+			}
 			x->setmyhb(me->getmyhb());
 			if(n->getstatus() == DEAD) {
 			  _memberList_del(n->getAddress(&b)->addr);
 				log->logNodeRemove(me->getAddress(&a), &b);
 			}
+			armTimer(i);
 		}
   }
-  if(gssp)
-	  if(find(gossipList.begin(), gossipList.end(), x)==gossipList.end())
-	    gossipList.insert(gossipList.begin(), x);
+  if(gssp && !x->isgossiped()) {
+    x->setgossiped(true);
+    gossipList.insert(gossipList.begin(), i);
+  }
 }
 
 void Operation::showPeersList() {
-  nodeEntry *p = first;
+  int p = peers.getFirst();
   int i = 0;
   cout << "\nPeers List ------------------------------------\n";
   cout << "me: ";
   me->show();
-  while(p) {
+  while(p >= 0) {
     cout << i++ << ": ";
-    p->show();
-    p = p->getNext();
+    peers.at(p)->show();
+    p = peers.at(p)->getNext();
   }
 }
 
 void Operation::showPingList() {
-	vector<nodeEntry *>::iterator it;
+	vector<int>::iterator it;
   int i=0;
   cout << "\nPing List ------------------------------------\n";
 	cout << "me: ";
   me->show();
   for(it=pingList.begin() ; it != pingList.end(); it++) {
     cout << i++ << ": ";
-    (*it)->show();
+    peers.at(*it)->show();
   }
 }
 
 void Operation::showGossipList() {
-  vector<nodeEntry *>::iterator it;
+  vector<int>::iterator it;
   int i=0;
   cout << "\nGossip List ------------------------------------\n";
   for(it=gossipList.begin() ; it != gossipList.end(); it++) {
     cout << i++ << ": ";
-    (*it)->show();
+    peers.at(*it)->show();
   }
 }
 
@@ -765,28 +851,11 @@ MsgTypes Operation::decode(char *iMsg) {
 	return t;
 }
 
+/* ----------------------------------------
+   Suspect/dead transitions due by now
+   ----------------------------------------- */
 void Operation::statusEval() {
-	nodeEntry *n = this->first;
-	Address a, b;
-	while(n) {
-		if(n->getstatus() == DEAD) {
-			n = n->getNext();
-			continue;
-		}
-		if(n->getElapsedt() >= TFAIL) {
-			if(n->getElapsedt() >= TREMOVE) {
-				n->setstatus(DEAD);
-				_memberList_del(n->getAddress(&b)->addr);
-				log->logNodeRemove(me->getAddress(&a), &b);
-			} else {
-				n->setstatus(SUSPECT);
-			}
-			n->setmyhb(me->getmyhb());
-			if(find(gossipList.begin(), gossipList.end(), n)==gossipList.end())
-			  gossipList.insert(gossipList.begin(), n);
-		}
-		n = n->getNext();
-	}
+	fdTimers.advance(par->getcurrtime(), [this](int i) { expireTimer(i); });
 }
 
 /* ----------------------- end op.cpp ---------------------------- */
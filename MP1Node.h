@@ -9,12 +9,12 @@
 #define _MP1NODE_H_
 
 #include "stdincludes.h"
-#include <random>
 #include "Log.h"
 #include "Params.h"
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
+#include "TimerWheel.h"
 
 /**
  * Macros
@@ -79,19 +79,29 @@ private:
   char addr[ADDRSZ];
   long hb, myhb;
   int tstamp;
+  // deadline of the failure detection timer pending for this peer, -1 if none
+  int timerAt;
   Statuses status;
   Params *par;
-  nodeEntry *prev, *next;
+  // index views of the peer table: list links, position in memberList, position in
+  // the ping permutation, gossip flag
+  int prev, next, mlPos, pingAt;
+  bool gossiped;
 public:
-  nodeEntry() {};
+  nodeEntry(): prev(-1), next(-1), mlPos(-1), pingAt(-1), gossiped(false) {};
   nodeEntry(char *addr, long hb, long myhb, Statuses status, Params *par);
   nodeEntry(char **b, Params *par, long myhb=0) { decode(b, par); setmyhb(myhb); };
   ~nodeEntry() {};
-  nodeEntry *add(nodeEntry *i);
-  nodeEntry *find(char *addr);
-  nodeEntry *unlink();
-  nodeEntry *getNext() { return this->next; };
-  nodeEntry *getPrev() { return this->prev; };
+  int getNext() { return this->next; };
+  int getPrev() { return this->prev; };
+  void setNext(int next) { this->next = next; };
+  void setPrev(int prev) { this->prev = prev; };
+  int getmlpos() { return this->mlPos; };
+  void setmlpos(int mlPos) { this->mlPos = mlPos; };
+  int getpingpos() { return this->pingAt; };
+  void setpingpos(int pingAt) { this->pingAt = pingAt; };
+  bool isgossiped() { return this->gossiped; };
+  void setgossiped(bool gossiped) { this->gossiped = gossiped; };
   char *getaddr() { return this->addr; };
   Address *getAddress(Address *a) {
   	memcpy(a->addr, this->addr, sizeof(this->addr));
@@ -102,6 +112,8 @@ public:
   Statuses getstatus() { return this->status; };
   int gettstamp() { return this->tstamp; };
   int getElapsedt() { return (par->getcurrtime() - this->tstamp); };
+  int gettimer() { return this->timerAt; };
+  void settimer(int timerAt) { this->timerAt = timerAt; };
   void setaddr(char *addr) {
     memcpy(this->addr, addr, sizeof(this->addr));
   }
@@ -129,20 +141,55 @@ public:
   char *encode(char **b);
   char *decode(char **b, Params *par);
   void show();
-  bool isFirst() { return !this->prev; }
-  bool isLast() { return !this->next; }
+  bool isFirst() { return this->prev < 0; }
+  bool isLast() { return this->next < 0; }
   nodeEntry& operator =(const nodeEntry &anotherNodeEntry);
   bool operator ==(const nodeEntry &anotherNodeEntry);
   bool operator <(const nodeEntry &anotherNodeEntry);
   bool operator >(const nodeEntry &anotherNodeEntry);
 };
 
+/*
+ * Peer table: peers live in a flat vector and are referred to by index.
+ * An open addressing index on the 6 byte address finds them, and they are
+ * linked in insertion order. Peers are never removed, dead ones stay.
+ */
+#define PEERTABLE_MINSZ 64
+
+class PeerTable {
+private:
+  vector<nodeEntry> peers;
+  // indexes into peers, -1 for a free slot
+  vector<int> slots;
+  size_t mask;
+  int first, last;
+  size_t home(const char *addr);
+  void grow();
+public:
+  PeerTable(): slots(PEERTABLE_MINSZ, -1), mask(PEERTABLE_MINSZ - 1), first(-1), last(-1) {};
+  int find(char *addr);
+  int add(nodeEntry &n);
+  nodeEntry *at(int i) { return &peers[i]; };
+  int getFirst() { return first; };
+  int getLast() { return last; };
+  int size() { return (int) peers.size(); };
+};
+
 class Operation {
 private:
-  nodeEntry *peersList, *me, *first, *last;
+  PeerTable peers;
+  nodeEntry *me;
+  // round robin cursor of the gossip list refill
+  int gossipPos;
   Member *memberNode;
   EmulNet *emulNet;
-  vector<nodeEntry *> pingList, gossipList;
+  vector<int> pingList, gossipList;
+  // persistent ping permutation, pinged round robin and reshuffled every round
+  vector<int> pingOrder;
+  size_t pingPos;
+  Random pingRng;
+  // suspect/dead transitions of the peers
+  TimerWheel<int> fdTimers;
   size_t recsz, msgSz;
   char msgBff[MAXMSGSZ];
   Address *from, *to;
@@ -153,8 +200,12 @@ public:
   Operation() {};
   Operation(Member *memberNode, Statuses status, EmulNet *emulNet, Params *par, Log *log);
   ~Operation();
-  void destroyPeersList(nodeEntry *n);
-  void initPingList();
+  void initPingList(int n);
+  void setPingAt(size_t p, int i);
+  void addPingTarget(int i);
+  void armTimer(int i);
+  void expireTimer(int i);
+  nodeEntry *peer(int i) { return peers.at(i); };
   char *getHeader(MsgTypes t, char *iAddr=NULL);
   int updtGossipLst(int n);
   char *addPayload(char **b);
@@ -174,11 +225,13 @@ public:
   void send(char *addr) {
     emulNet->ENsend(from, getToAddress(addr), msgBff, msgSz);
   };
-  vector<nodeEntry *> getpingList() { return pingList; };
-  vector<nodeEntry *> getgossipList() { return gossipList; };
+  vector<int> &getpingList() { return pingList; };
+  vector<int> &getgossipList() { return gossipList; };
   vector<MemberListEntry>::iterator _memberList_add(char *addr, long hb, long ts);
   vector<MemberListEntry>::iterator _memberList_search(char *addr);
   vector<MemberListEntry>::iterator _memberList_del(char *addr);
+  nodeEntry *_memberList_owner(char *addr);
+  void _ringEvent(RingEventType type, char *addr);
 };
 
 
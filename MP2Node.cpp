@@ -8,24 +8,29 @@
 /**
  * constructor
  */
-MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log, Address * address) {
+MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log, Address * address): pendTimers(par->getcurrtime()) {
 	this->memberNode = memberNode;
 	this->par = par;
 	this->emulNet = emulNet;
 	this->log = log;
-	ht = new HashTable();
 	this->memberNode->addr = *address;
 	this->transID = 0;
-	this->pendR.clear();
-	this->pendCUD.clear();
 	this->tbDelKey.clear();
+	this->repairsSent = 0;
+	this->repairsApplied = 0;
+	this->lateReplies = 0;
+	this->reads = this->readMsgs = this->hedges = this->readReplies = 0;
+	this->batchMsgs = this->batchRecords = 0;
+	store = new KVStore(par, *(int *)(address->addr));
+	hints = new HintStore(par, *(int *)(address->addr));
 }
 
 /**
  * Destructor
  */
 MP2Node::~MP2Node() {
-	delete ht;
+	delete hints;
+	delete store;
 	delete memberNode;
 }
 
@@ -33,57 +38,97 @@ MP2Node::~MP2Node() {
  * FUNCTION NAME: updateRing
  *
  * DESCRIPTION: This function does the following:
- * 				1) Gets the current membership list from the Membership Protocol (MP1Node)
- * 				   The membership list is returned as a vector of Nodes. See Node class in Node.h
- * 				2) Constructs the ring based on the membership list
- * 				3) Calls the Stabilization Protocol
+ * 				1) Takes the membership changes queued by the Membership Protocol (MP1Node)
+ * 				   since the last call. Nothing else is done when there are none.
+ * 				2) Applies them to the ring in place, adding or removing the tokens
+ * 				   of the members that joined or left. Suspected members keep their
+ * 				   tokens, their writes become hints until they are alive again.
+ * 				3) Calls the Stabilization Protocol if the ring changed, against the
+ * 				   ring as it was before the first change
  */
 void MP2Node::updateRing() {
-	/*
-	 * Implement this. Parts of it are already implemented
-	 */
-	vector<Node> newRing, oldReplicas, newReplicas;
-	map<string, string>::iterator hit;
-	vector<Node>::iterator rit;
+	Ring oldRing;
+	ReplicaSet oldReplicas, newReplicas;
 	vector<TbDelKey>::iterator dit;
-	bool changed = false;
+	vector<ring_event>::iterator eit;
+	bool hadReplicas, isNew, keep, changed = false;
+	size_t pos;
+	int version;
+	string_view value;
 
 	/*
-	 *  Step 1. Get the current membership list from Membership Protocol / MP1
+	 *  Step 1. Get the membership changes from Membership Protocol / MP1
 	 */
-	newRing = getMembershipList();
+	if(memberNode->ringEvents.empty()) return;
 
 	/*
-	 * Step 2: Construct the ring
+	 * Step 2: Update the ring
 	 */
-	// Sort the list based on the hashCode
-	sort(newRing.begin(), newRing.end());
-
+	// the stabilization protocol needs the replicas of before, the ring is copied
+	// once, ahead of the first event that changes it
+	auto changing = [&]() {
+		if(!changed) oldRing = ring;
+		changed = true;
+	};
+	for( eit = memberNode->ringEvents.begin(); eit != memberNode->ringEvents.end(); eit++ ) {
+		switch(eit->type) {
+			case RING_JOIN:
+				if(ring.contains(eit->addr)) break;
+				changing();
+				ring.insert(eit->addr, par->VNODES);
+				break;
+			case RING_LEAVE:
+				if(ring.contains(eit->addr)) {
+					changing();
+					ring.remove(eit->addr);
+				}
+				hints->drop(eit->addr);
+				break;
+			case RING_RESET:
+				if(ring.size() > 0) {
+					changing();
+					ring.clear();
+				}
+				hints->clear();
+				break;
+			case RING_SUSPECT:
+				if(par->HINTS) hints->markDown(eit->addr);
+				break;
+			case RING_ALIVE:
+				hints->markUp(eit->addr);
+				break;
+		}
+	}
+	memberNode->ringEvents.clear();
 
 	/*
 	 * Step 3: Run the stabilization protocol IF REQUIRED
 	 */
 	// Run stabilization protocol if the hash table size is greater than zero and if there has been a changed in the ring
-	changed = (ring.size() != newRing.size());
-	for( int i; !changed && i < (int) ring.size(); i++ )
-	  changed = (ring.at(i).nodeHashCode == newRing.at(i).nodeHashCode);
 	if(!changed) return;
-	for( hit = ht->hashTable.begin(); hit != ht->hashTable.end(); hit++ ) {
-  	oldReplicas = findNodes(hit->first);
-		newReplicas = findNewNodes(hit->first, newRing);
-		for( rit = newReplicas.begin(); rit != newReplicas.end(); rit++ ) {
-			if(!isListed(rit->nodeAddress, oldReplicas))
-				stblznCreate(hit->first, hit->second, &(*rit));
+	store->forEach([&](string_view key, string_view stored) {
+		if(!Entry::decode(stored, &version, &value)) return;
+		pos = hashFunction(key);
+		hadReplicas = oldRing.findReplicas(pos, oldReplicas);
+		if(!ring.findReplicas(pos, newReplicas)) return;
+		keep = false;
+		for( int i = 0; i < RING_REPLICAS; i++ ) {
+			Node &n = ring.at(newReplicas[i]);
+			isNew = true;
+			for( int j = 0; hadReplicas && isNew && j < RING_REPLICAS; j++ )
+				isNew = !(oldRing.at(oldReplicas[j]).nodeAddress == n.nodeAddress);
+			if(isNew) stblznCreate(string(key), string(value), version, &n);
+			if(n.nodeAddress == memberNode->addr) keep = true;
 		}
-	  if(!isListed(memberNode->addr, newReplicas)) tbDelKey.emplace_back(hit->first, getTimeStamp());
-	}
+		if(!keep) tbDelKey.emplace_back(string(key), getTimeStamp());
+	});
 	for( dit = tbDelKey.begin(); dit != tbDelKey.end(); ) {
 	  if(dit->delReady(getTimeStamp())) {
-			ht->deleteKey(dit->getKey());
+			store->remove(dit->getKey());
 			dit = tbDelKey.erase(dit);
 		} else { dit++; }
 	}
-	ring.swap(newRing);
+	store->commit();
 }
 
 /**
@@ -117,12 +162,11 @@ vector<Node> MP2Node::getMembershipList() {
  * 				HASH FUNCTION USED FOR CONSISTENT HASHING
  *
  * RETURNS:
- * size_t position on the ring
+ * size_t position on the 64 bit ring
  */
-size_t MP2Node::hashFunction(string key) {
-	std::hash<string> hashFunc;
-	size_t ret = hashFunc(key);
-	return ret%RING_SIZE;
+size_t MP2Node::hashFunction(string_view key) {
+	std::hash<string_view> hashFunc;
+	return hashFunc(key);
 }
 
 /**
@@ -132,19 +176,19 @@ size_t MP2Node::hashFunction(string key) {
  * 				The function does the following:
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
- * 				3) Sends a message to the replica
+ * 				3) Sends a message to the replica, or keeps it as a hint if the replica is down
  */
 void MP2Node::clientCreate(string key, string value) {
-	vector<Node> node = findNodes(key);
-  if(node.size() < 3) return;
-	string msgBff;
+	ReplicaSet node;
+	int sent = 0;
+  if(!ring.findReplicas(hashFunction(key), node)) return;
   Message message(++transID, memberNode->addr, CREATE, key, value, PRIMARY);
-	for(int i=0; i<3; i++) {
+	message.timestamp = getTimeStamp();
+	for(int i=0; i<RING_REPLICAS; i++) {
 		message.replica = static_cast<ReplicaType>(i);
-		msgBff = message.toString();
-		emulNet->ENsend(&memberNode->addr, &node.at(i).nodeAddress, msgBff);
+		sent += sendWrite(message, &ring.at(node[i]).nodeAddress);
 	}
-	pendCUD.emplace_back(transID, CREATE, par->getcurrtime(), key, value);
+	newPendWrDl(CREATE, key, value)->setExpected(sent);
 }
 
 /**
@@ -154,17 +198,29 @@ void MP2Node::clientCreate(string key, string value) {
  * 				The function does the following:
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
- * 				3) Sends a message to the replica
+ * 				3) Sends a message to the replica. With HEDGED_READS only the
+ * 				   READ_QUORUM replicas with the best round trip average are asked,
+ * 				   the next one is too if they have not answered after HEDGE_AFTER
+ * 				   of the timeout, and its reply can still come before the timeout.
  */
 void MP2Node::clientRead(string key){
-	vector<Node> node = findNodes(key);
-	if(node.size() < 3) return;
-	string msgBff;
+	ReplicaSet node;
+	Address to[RING_REPLICAS];
+	int n = RING_REPLICAS;
+	if(!ring.findReplicas(hashFunction(key), node)) return;
   Message message(++transID, memberNode->addr, READ, key);
-	msgBff = message.toString();
-	for(int i=0; i<3; i++)
-		emulNet->ENsend(&memberNode->addr, &node.at(i).nodeAddress, msgBff);
-	pendR.emplace_back(transID, par->getcurrtime(), key);
+	for(int i=0; i<RING_REPLICAS; i++)
+		to[i] = ring.at(node[i]).nodeAddress;
+	if(par->HEDGED_READS) {
+		rankReplicas(to);
+		n = par->READ_QUORUM;
+		pendTimers.schedule(transID, getTimeStamp() + max(1, (int) lround(par->HEDGE_AFTER * QTMOUT)));
+	}
+	for(int i=0; i<n; i++)
+		sendMessage(message, &to[i]);
+	newPendRead(key)->setTargets(to, n);
+	reads++;
+	readMsgs += n;
 }
 
 /**
@@ -174,19 +230,19 @@ void MP2Node::clientRead(string key){
  * 				The function does the following:
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
- * 				3) Sends a message to the replica
+ * 				3) Sends a message to the replica, or keeps it as a hint if the replica is down
  */
 void MP2Node::clientUpdate(string key, string value){
-	vector<Node> node = findNodes(key);
-	if(node.size() < 3) return;
-	string msgBff;
+	ReplicaSet node;
+	int sent = 0;
+	if(!ring.findReplicas(hashFunction(key), node)) return;
   Message message(++transID, memberNode->addr, UPDATE, key, value, PRIMARY);
-	for(int i=0; i<3; i++) {
+	message.timestamp = getTimeStamp();
+	for(int i=0; i<RING_REPLICAS; i++) {
 		message.replica = static_cast<ReplicaType>(i);
-		msgBff = message.toString();
-		emulNet->ENsend(&memberNode->addr, &node.at(i).nodeAddress, msgBff);
+		sent += sendWrite(message, &ring.at(node[i]).nodeAddress);
 	}
-	pendCUD.emplace_back(transID, UPDATE, par->getcurrtime(), key, value);
+	newPendWrDl(UPDATE, key, value)->setExpected(sent);
 }
 
 /**
@@ -196,17 +252,66 @@ void MP2Node::clientUpdate(string key, string value){
  * 				The function does the following:
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
- * 				3) Sends a message to the replica
+ * 				3) Sends a message to the replica, or keeps it as a hint if the replica is down
  */
 void MP2Node::clientDelete(string key){
-	vector<Node> node = findNodes(key);
-	if(node.size() < 3) return;
-	string msgBff;
+	ReplicaSet node;
+	int sent = 0;
+	if(!ring.findReplicas(hashFunction(key), node)) return;
   Message message(++transID, memberNode->addr, DELETE, key);
-	msgBff = message.toString();
-	for(int i=0; i<3; i++)
-		emulNet->ENsend(&memberNode->addr, &node.at(i).nodeAddress, msgBff);
-	pendCUD.emplace_back(transID, DELETE, par->getcurrtime(), key, "");
+	// the version of the tombstone
+	message.timestamp = getTimeStamp();
+	for(int i=0; i<RING_REPLICAS; i++) {
+		message.replica = static_cast<ReplicaType>(i);
+		sent += sendWrite(message, &ring.at(node[i]).nodeAddress);
+	}
+	newPendWrDl(DELETE, key, "")->setExpected(sent);
+}
+
+/**
+ * FUNCTION NAME: multiGet
+ *
+ * DESCRIPTION: client side READ API for many keys
+ * 				The function does the following:
+ * 				1) Finds the replicas of each key
+ * 				2) Packs the keys of each replica in as few BATCH messages as fit
+ * 				3) Waits for the quorum of each key on its own, in one pending batch
+ */
+void MP2Node::multiGet(const vector<string> &keys) {
+	vector< pair<string, string> > kv;
+	for(size_t i=0; i<keys.size(); i++) kv.emplace_back(keys[i], "");
+	sendBatch(READ, kv);
+}
+
+/**
+ * FUNCTION NAME: multiPut
+ *
+ * DESCRIPTION: client side CREATE API for many keys
+ * 				The function does the following:
+ * 				1) Finds the replicas of each key
+ * 				2) Packs the pairs of each replica in as few BATCH messages as fit,
+ * 				   or keeps them as hints if the replica is down
+ * 				3) Waits for the quorum of each key on its own, in one pending batch
+ */
+void MP2Node::multiPut(const map<string, string> &pairs) {
+	vector< pair<string, string> > kv(pairs.begin(), pairs.end());
+	sendBatch(CREATE, kv);
+}
+
+/**
+ * FUNCTION NAME: multiDelete
+ *
+ * DESCRIPTION: client side DELETE API for many keys
+ * 				The function does the following:
+ * 				1) Finds the replicas of each key
+ * 				2) Packs the keys of each replica in as few BATCH messages as fit,
+ * 				   or keeps them as hints if the replica is down
+ * 				3) Waits for the quorum of each key on its own, in one pending batch
+ */
+void MP2Node::multiDelete(const vector<string> &keys) {
+	vector< pair<string, string> > kv;
+	for(size_t i=0; i<keys.size(); i++) kv.emplace_back(keys[i], "");
+	sendBatch(DELETE, kv);
 }
 
 /**
@@ -214,17 +319,24 @@ void MP2Node::clientDelete(string key){
  *
  * DESCRIPTION: Server side CREATE API
  * 			   	The function does the following:
- * 			   	1) Inserts key value into the local hash table
+ * 			   	1) Inserts key value into the local hash table, as an Entry with the
+ * 			   	   version given by the coordinator. It replaces the tombstone of
+ * 			   	   an older delete of the key.
  * 			   	2) Return true or false based on success or failure
  */
-bool MP2Node::createKeyValue(int transID, string key, string value, ReplicaType replica) {
-	vector<Node> node = findNodes(key);
-  bool addKey = false;
-	for(int i=0; i<3 && !addKey; i++)
-		addKey = (memberNode->addr == node.at(i).nodeAddress);
-	if(ht->count(key) > 0) addKey = false;
+bool MP2Node::createKeyValue(int transID, string_view key, string_view value, ReplicaType replica, int timestamp) {
+  bool addKey = ring.isReplica(hashFunction(key), memberNode->addr);
+	string_view found, current;
+	int version;
+	if(addKey) {
+		Entry::encode(entryBff, timestamp, value, replica);
+		if(store->read(key, found))
+			addKey = Entry::decode(found, &version, &current) && current.empty() &&
+				Entry::newer(timestamp, value, version, current) && store->update(key, entryBff);
+		else
+			addKey = store->create(key, entryBff);
+	}
 	if(addKey) {
-		addKey = ht->create(key, value);
 	  log->logCreateSuccess(&memberNode->addr, false, transID, key, value);
 	} else
 	  log->logCreateFail(&memberNode->addr, false, transID, key, value);
@@ -237,21 +349,22 @@ bool MP2Node::createKeyValue(int transID, string key, string value, ReplicaType
  * DESCRIPTION: Server side READ API
  * 			    This function does the following:
  * 			    1) Read key from local hash table
- * 			    2) Return value
+ * 			    2) Return true if found, with the value and its version in timestamp.
+ * 			       value points into the store, until its next write. A deleted key
+ * 			       is not found, timestamp is the version of its tombstone.
  */
-string MP2Node::readKey(int transID, string key) {
-	vector<Node> node = findNodes(key);
-	string v = "";
-  bool readKey = false;
-	for(int i=0; i<3 && !readKey; i++)
-		readKey = (memberNode->addr == node.at(i).nodeAddress);
+bool MP2Node::readKey(int transID, string_view key, int &timestamp, string_view &value) {
+  bool readKey = ring.isReplica(hashFunction(key), memberNode->addr);
+	string_view found;
+	timestamp = 0;
+	readKey = readKey && store->read(key, found) && Entry::decode(found, &timestamp, &value) && !value.empty();
 	if(readKey) {
-	  v = ht->read(key);
-		if(v != "") log->logReadSuccess(&memberNode->addr, false, transID, key, v);
-		else log->logReadFail(&memberNode->addr, false, transID, key);
-	} else
+	  log->logReadSuccess(&memberNode->addr, false, transID, key, value);
+	} else {
+	  value = string_view();
 	  log->logReadFail(&memberNode->addr, false, transID, key);
-	return v;
+	}
+	return readKey;
 }
 
 /**
@@ -259,39 +372,72 @@ string MP2Node::readKey(int transID, string key) {
  *
  * DESCRIPTION: Server side UPDATE API
  * 				This function does the following:
- * 				1) Update the key to the new value in the local hash table
+ * 				1) Update the key to the new value in the local hash table. An update
+ * 				   older than the stored version, a late hint say, is acknowledged
+ * 				   but not applied: last write wins. A deleted key is not found.
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::updateKeyValue(int transID, string key, string value, ReplicaType replica) {
-	vector<Node> node = findNodes(key);
-  bool updtKey = false;
-	for(int i=0; i<3 && !updtKey; i++)
-		updtKey = (memberNode->addr == node.at(i).nodeAddress);
-	if(ht->count(key) != 1) updtKey = false;
+bool MP2Node::updateKeyValue(int transID, string_view key, string_view value, ReplicaType replica, int timestamp) {
+  bool updtKey = ring.isReplica(hashFunction(key), memberNode->addr);
+	string_view found, current;
+	int version;
+	updtKey = updtKey && store->read(key, found) && Entry::decode(found, &version, &current) && !current.empty();
+	if(updtKey && !Entry::newer(version, current, timestamp, value)) {
+		Entry::encode(entryBff, timestamp, value, replica);
+		updtKey = store->update(key, entryBff);
+	}
 	if(updtKey) {
-		updtKey = ht->update(key, value);
 	  log->logUpdateSuccess(&memberNode->addr, false, transID, key, value);
 	} else
 	  log->logUpdateFail(&memberNode->addr, false, transID, key, value);
 	return updtKey;
 }
 
+/**
+ * FUNCTION NAME: repairKey
+ *
+ * DESCRIPTION: Server side of read repair and hinted handoff
+ * 				This function does the following:
+ * 				1) Stores the version sent by the coordinator, unless the local hash
+ * 				   table holds the same or a newer one. An empty value is a delete.
+ * 				2) Return true if it was stored. Nothing is logged nor replied.
+ */
+bool MP2Node::repairKey(string_view key, string_view value, ReplicaType replica, int timestamp) {
+	string_view found, current;
+	int version;
+	bool had;
+	if(!ring.isReplica(hashFunction(key), memberNode->addr)) return false;
+	had = store->read(key, found);
+	if(had && Entry::decode(found, &version, &current) && !Entry::newer(timestamp, value, version, current)) return false;
+	Entry::encode(entryBff, timestamp, value, replica);
+	if(had ? !store->update(key, entryBff) : !store->create(key, entryBff))
+		return false;
+	if(value.empty()) tombstones.emplace(string(key), getTimeStamp());
+	repairsApplied++;
+	return true;
+}
+
 /**
  * FUNCTION NAME: deleteKey
  *
  * DESCRIPTION: Server side DELETE API
  * 				This function does the following:
- * 				1) Delete the key from the local hash table
+ * 				1) Replaces the value of the key in the local hash table with a
+ * 				   tombstone, of the version given by the coordinator. A delete older
+ * 				   than the stored version is acknowledged but not applied.
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::deletekey(int transID, string key) {
-	vector<Node> node = findNodes(key);
-  bool delKey = false;
-	for(int i=0; i<3 && !delKey; i++)
-		delKey = (memberNode->addr == node.at(i).nodeAddress);
-	if(ht->count(key) != 1) delKey = false;
+bool MP2Node::deletekey(int transID, string_view key, ReplicaType replica, int timestamp) {
+  bool delKey = ring.isReplica(hashFunction(key), memberNode->addr);
+	string_view found, current;
+	int version;
+	delKey = delKey && store->read(key, found) && Entry::decode(found, &version, &current) && !current.empty();
+	if(delKey && Entry::newer(timestamp, "", version, current)) {
+		Entry::encode(entryBff, timestamp, "", replica);
+		delKey = store->update(key, entryBff);
+		if(delKey) tombstones.emplace(string(key), getTimeStamp());
+	}
 	if(delKey) {
-		delKey = ht->deleteKey(key);
 	  log->logDeleteSuccess(&memberNode->addr, false, transID, key);
 	} else
 	  log->logDeleteFail(&memberNode->addr, false, transID, key);
@@ -307,52 +453,79 @@ bool MP2Node::deletekey(int transID, string key) {
  * 				2) Handles the messages according to message types
  */
 void MP2Node::checkMessages() {
-	char *data;
-	int size;
-	bool sendMsg = true;
+	bool sendMsg;
 	Address toAddr;
+	MessageView Msg;
 
 	while ( !memberNode->mp2q.empty() ) {
-		data = (char *)memberNode->mp2q.front().elt;
-		size = memberNode->mp2q.front().size;
+		sendMsg = true;
+		// msg keeps the buffer alive until it goes out of scope, the key and the
+		// value of Msg point into it
+		q_elt msg = memberNode->mp2q.front();
 		memberNode->mp2q.pop();
-		string message(data, data + size);
-		Message Msg(message);
+		// a malformed message has no sender to answer to
+		if ( !Message::parse((const char *) msg.elt, msg.size, &Msg) ) continue;
     switch(Msg.type) {
 			case CREATE:
-			  Msg.success = createKeyValue(Msg.transID, Msg.key, Msg.value, Msg.replica);
+			  Msg.success = createKeyValue(Msg.transID, Msg.key, Msg.value, Msg.replica, Msg.timestamp);
 				Msg.type = REPLY;
 			  break;
 			case UPDATE:
-			  Msg.success = updateKeyValue(Msg.transID, Msg.key, Msg.value, Msg.replica);
+			  Msg.success = updateKeyValue(Msg.transID, Msg.key, Msg.value, Msg.replica, Msg.timestamp);
 				Msg.type = REPLY;
 				break;
 			case READ:
-			  Msg.value = readKey(Msg.transID, Msg.key);
-				Msg.success = (Msg.value != "");
+			  Msg.success = readKey(Msg.transID, Msg.key, Msg.timestamp, Msg.value);
 				Msg.type = READREPLY;
 			  break;
 			case DELETE:
-			  Msg.success = deletekey(Msg.transID, Msg.key);
+			  Msg.success = deletekey(Msg.transID, Msg.key, Msg.replica, Msg.timestamp);
 				Msg.type = REPLY;
 				break;
 			case REPLY:
-			  setPendWrDl(Msg.transID, Msg.success);
+			  setPendWrDl(Msg.transID, Msg.fromAddr, Msg.success);
 				sendMsg = false;
 				break;
 			case READREPLY:
-			  setPendRead(Msg.transID, Msg.value);
+				readReplies++;
+			  setPendRead(Msg.transID, Msg.fromAddr, Msg.value, Msg.timestamp);
 				sendMsg = false;
 			  break;
+			case REPAIR:
+				repairKey(Msg.key, Msg.value, Msg.replica, Msg.timestamp);
+				sendMsg = false;
+				break;
+			case BATCH:
+				serveBatch(Msg);
+				sendMsg = false;
+				break;
+			case BATCHREPLY:
+				setPendBatch(Msg);
+				sendMsg = false;
+				break;
 		}
 		if(sendMsg) {
 			toAddr = Msg.fromAddr;
 			Msg.fromAddr = memberNode->addr;
-			emulNet->ENsend(&memberNode->addr, &toAddr, Msg.toString());
+			reply(Msg, toAddr);
 		}
 	}
-	checkPendRead();
-	checkPendWrDl();
+	// group commit of the writes of this drain, their replies go once it is durable.
+	// The memtable holds the writes either way, if the log failed they are acked as
+	// failures: the coordinator must not count them durable.
+	if(!store->commit()) {
+		if(!deferred.empty()) log->LOG(&memberNode->addr, "write-ahead log commit failed, %d replies sent as failures", (int) deferred.size());
+		for(size_t i = 0; i < deferred.size(); i++)
+			failReply(deferred[i].first);
+	}
+	for(size_t i = 0; i < deferred.size(); i++)
+		sendMessage(deferred[i].first, &deferred[i].second);
+	deferred.clear();
+	// flush the memtable to a new run when it is due
+	store->maintain(getTimeStamp());
+	purgeTombstones();
+	replayHints();
+	checkPendTimeouts();
 }
 
 /**
@@ -362,27 +535,11 @@ void MP2Node::checkMessages() {
  * 				This function is responsible for finding the replicas of a key
  */
 vector<Node> MP2Node::findNodes(string key) {
-	size_t pos = hashFunction(key);
+	ReplicaSet replicas;
 	vector<Node> addr_vec;
-	if (ring.size() >= 3) {
-		// if pos <= min || pos > max, the leader is the min
-		if (pos <= ring.at(0).getHashCode() || pos > ring.at(ring.size()-1).getHashCode()) {
-			addr_vec.emplace_back(ring.at(0));
-			addr_vec.emplace_back(ring.at(1));
-			addr_vec.emplace_back(ring.at(2));
-		}
-		else {
-			// go through the ring until pos <= node
-			for (int i = 1; i < (int) ring.size(); i++){
-				Node addr = ring.at(i);
-				if (pos <= addr.getHashCode()) {
-					addr_vec.emplace_back(addr);
-					addr_vec.emplace_back(ring.at((i+1)%ring.size()));
-					addr_vec.emplace_back(ring.at((i+2)%ring.size()));
-					break;
-				}
-			}
-		}
+	if (ring.findReplicas(hashFunction(key), replicas)) {
+		for (int i = 0; i < RING_REPLICAS; i++)
+			addr_vec.emplace_back(ring.at(replicas[i]));
 	}
 	return addr_vec;
 }
@@ -425,30 +582,54 @@ void MP2Node::stabilizationProtocol() {
 	 */
 }
 
+/* ----------------------------------------
+   A read is answered by the first
+   READ_QUORUM replies, with the newest
+   version among them, or fails if none
+   of them has the key or the newest is a
+   delete
+   ----------------------------------------- */
 QuorumStat pendingRead::gotQuorum(int currTime) {
-	QuorumStat r;
-	int n = 0;
-	if((currTime - timestamp) < QTMOUT) {
-		if(q == 3) r = QSUCCESS;
-		else r = QWAIT;
-	} else {
-		if(q >= 2) r = QSUCCESS;
-		else r = QFAIL;
-  }
-	if(r == QSUCCESS) {
-		if(value[0] != "") {
-			n++;
-			if(value[0] == value[1]) n++;
-			if(value[0] == value[2]) n++;
-		} else if(value[1] != "") {
-			n++;
-			if(value[1] == value[2]) n++;
-		} else if(value[2] != "") {
-			n++;
-		}
-		if(n < 2) r = QFAIL;
+	if(q >= need) return (getValue() != "") ? QSUCCESS : QFAIL;
+	if((currTime - timestamp) < QTMOUT) return QWAIT;
+	return QFAIL;
+}
+
+void pendingRead::setTargets(Address *to, int nsent) {
+	for(int i=0; i<3; i++) {
+		this->to[i] = to[i];
+		sentAt[i] = timestamp;
 	}
-	return r;
+	this->nsent = nsent;
+}
+
+bool pendingRead::hasReplied(Address &addr) {
+	for(int i=0; i<q; i++)
+		if(from[i] == addr) return true;
+	return false;
+}
+
+int pendingRead::setValue(Address &from, string_view v, int version) {
+	if(q == 3) return q;
+	this->from[q] = from;
+	this->version[q] = version;
+	value[q++].assign(v.data(), v.size());
+	return q;
+}
+
+int pendingRead::newest() {
+	int n = -1;
+	for(int i=0; i<q; i++)
+		if(has(i) && (n < 0 || Entry::newer(version[i], value[i], version[n], value[n]))) n = i;
+	return n;
+}
+
+// the reply i holds an older version than the newest reply, which may be a delete.
+// A replica without the key is left alone: the create may still be on its way to
+// it, or it forgot an old tombstone.
+bool pendingRead::isStale(int i) {
+	int n = newest();
+	return n >= 0 && i != n && has(i) && Entry::newer(version[n], value[n], version[i], value[i]);
 }
 
 QuorumStat pendingWrDl::gotQuorum(int currTime) {
@@ -464,162 +645,548 @@ QuorumStat pendingWrDl::gotQuorum(int currTime) {
 			else r = QFAIL;
 	  }
 	} else {
-		if((currTime - timestamp) < QTMOUT) {
-			if(q == 3) r = QSUCCESS;
-			else r = QWAIT;
-		} else {
-			if(q >= 2) r = QSUCCESS;
-			else r = QFAIL;
-	  }
-		if(r == QSUCCESS) {
-			for(int i=0; i<3; i++)
-			  if(status[i]) n++;
-			if(n < 2) r = QFAIL;
-		}
+		// answered by WRITE_QUORUM successes, or once too many replicas failed or
+		// were not sent the write for them to come
+		for(int i=0; i<q; i++)
+		  if(status[i]) n++;
+		if(n >= need) r = QSUCCESS;
+		else if(q - n > expected - need) r = QFAIL;
+		else if((currTime - timestamp) < QTMOUT) r = QWAIT;
+		else r = QFAIL;
 	}
 	return r;
 }
 
-vector<pendingRead>::iterator MP2Node::findPendRead(int transID) {
-	vector<pendingRead>::iterator it;
-	for (it = pendR.begin() ; it != pendR.end(); it++)
-		if(it->getTransID() == transID) break;
-	return it;
+/* ----------------------------------------
+   Register a new pending request, it expires
+   QTMOUT time units from now
+   ----------------------------------------- */
+pendingRead *MP2Node::newPendRead(string key) {
+	pendTimers.schedule(transID, getTimeStamp() + QTMOUT);
+	return pendR.insert(transID, pendingRead(transID, getTimeStamp(), key, par->READ_QUORUM));
 }
 
-vector<pendingWrDl>::iterator MP2Node::findPendWrDl(int transID) {
-	vector<pendingWrDl>::iterator it;
-	for (it = pendCUD.begin() ; it != pendCUD.end(); it++)
-		if(it->getTransID() == transID) break;
-	return it;
+pendingWrDl *MP2Node::newPendWrDl(MessageType mt, string key, string value) {
+	pendTimers.schedule(transID, getTimeStamp() + QTMOUT);
+	return pendCUD.insert(transID, pendingWrDl(transID, mt, getTimeStamp(), key, value, par->WRITE_QUORUM));
 }
 
-void MP2Node::setPendRead(int transID, string value) {
-	vector<pendingRead>::iterator it = findPendRead(transID);
-	if(it != pendR.end()) it->setValue(value);
+void MP2Node::setPendRead(int transID, Address &from, string_view value, int version) {
+	pendingRead *p = pendR.find(transID);
+	if(p) {
+		if(p->isDone()) lateReplies++;
+		for(int i=0; i<p->getSent(); i++)
+			if(p->getTarget(i) == from) sampleRtt(from, getTimeStamp() - p->getSentAt(i));
+		p->setValue(from, value, version);
+		checkPendRead(transID);
+	}
+}
+
+void MP2Node::setPendWrDl(int transID, Address &from, bool st) {
+	pendingWrDl *p = pendCUD.find(transID);
+	if(p) {
+		if(p->isDone()) lateReplies++;
+		sampleRtt(from, getTimeStamp() - p->getTimestamp());
+		p->setStatus(st);
+		checkPendWrDl(transID);
+	}
 }
 
-void MP2Node::setPendWrDl(int transID, bool st) {
-	vector<pendingWrDl>::iterator it = findPendWrDl(transID);
-	if(it != pendCUD.end()) it->setStatus(st);
+/* ----------------------------------------
+   Count the completion time of a client
+   request issued at since
+   ----------------------------------------- */
+void MP2Node::answered(MessageType mt, int since) {
+	size_t t = max(0, getTimeStamp() - since);
+	if(latency[mt].size() <= t) latency[mt].resize(t + 1, 0);
+	latency[mt][t]++;
 }
 
 string pendingRead::getValue() {
-  if(value[0] == value[1] || value[0] == value[2]) return value[0];
-	if(value[1] == value[2]) return value[1];
-	return "";
-}
-
-void MP2Node::checkPendRead() {
-	vector<pendingRead>::iterator rit;
-	for(rit=pendR.begin(); rit!=pendR.end(); ) {
-		switch(rit->gotQuorum(getTimeStamp())) {
-			case QSUCCESS:
-				log->logReadSuccess(&memberNode->addr, true, rit->getTransID(), rit->getKey(), rit->getValue());
-				rit = pendR.erase(rit);
-				break;
-			case QFAIL:
-				log->logReadFail(&memberNode->addr, true, rit->getTransID(), rit->getKey());
-				rit = pendR.erase(rit);
-				break;
-			case QWAIT:
-			  rit++;
+	int n = newest();
+	return (n >= 0) ? value[n] : "";
+}
+
+int pendingRead::getVersion() {
+	int n = newest();
+	return (n >= 0) ? version[n] : 0;
+}
+
+/* ----------------------------------------
+   Answer a pending request once it has
+   its quorum or has timed out. It stays
+   until every replica replied or the
+   timeout, for the late replies: then the
+   replicas that returned an older version
+   of a read key are repaired.
+   ----------------------------------------- */
+void MP2Node::checkPendRead(int transID) {
+	pendingRead *rit = pendR.find(transID);
+	if(rit) {
+		if(!answerRead(*rit)) return;
+		if(rit->isOver(getTimeStamp())) {
+			// a replica that never replied counts as slow as the wait
+			for(int i=0; i<rit->getSent(); i++)
+				if(!rit->hasReplied(rit->getTarget(i))) sampleRtt(rit->getTarget(i), getTimeStamp() - rit->getSentAt(i));
+			readRepair(*rit);
+			pendR.erase(transID);
+		}
+	}
+}
+
+void MP2Node::checkPendWrDl(int transID) {
+	pendingWrDl *wit = pendCUD.find(transID);
+	if(wit) {
+		if(!answerWrDl(*wit)) return;
+		// a stabilization copy has a single replica, nothing comes late
+		if(wit->isStblzn() || wit->isOver(getTimeStamp())) pendCUD.erase(transID);
+	}
+}
+
+/* ----------------------------------------
+   Log the outcome of a request once it
+   has its quorum or has timed out. Returns
+   false while it must wait.
+   ----------------------------------------- */
+bool MP2Node::answerRead(pendingRead &read) {
+	if(read.isDone()) return true;
+	switch(read.gotQuorum(getTimeStamp())) {
+		case QSUCCESS:
+			log->logReadSuccess(&memberNode->addr, true, read.getTransID(), read.getKey(), read.getValue());
+			break;
+		case QFAIL:
+			log->logReadFail(&memberNode->addr, true, read.getTransID(), read.getKey());
+			break;
+		case QWAIT:
+			return false;
+	}
+	read.setDone();
+	answered(READ, read.getTimestamp());
+	return true;
+}
+
+bool MP2Node::answerWrDl(pendingWrDl &write) {
+	if(write.isDone()) return true;
+	switch(write.gotQuorum(getTimeStamp())) {
+		case QSUCCESS:
+		  switch(write.getMt()) {
+				case CREATE:
+					log->logCreateSuccess(&memberNode->addr, true, write.getTransID(), write.getKey(), write.getValue());
+					break;
+				case UPDATE:
+					log->logUpdateSuccess(&memberNode->addr, true, write.getTransID(), write.getKey(), write.getValue());
+					break;
+				case DELETE:
+					log->logDeleteSuccess(&memberNode->addr, true, write.getTransID(), write.getKey());
+					break;
+				default:
+					break;
+			}
+			break;
+		case QFAIL:
+			switch(write.getMt()) {
+				case CREATE:
+					log->logCreateFail(&memberNode->addr, true, write.getTransID(), write.getKey(), write.getValue());
+					break;
+				case UPDATE:
+					log->logUpdateFail(&memberNode->addr, true, write.getTransID(), write.getKey(), write.getValue());
+					break;
+				case DELETE:
+					log->logDeleteFail(&memberNode->addr, true, write.getTransID(), write.getKey());
+					break;
+				default:
+					break;
+			}
+			break;
+		case QWAIT:
+			return false;
+	}
+	write.setDone();
+	if(!write.isStblzn()) answered(write.getMt(), write.getTimestamp());
+	return true;
+}
+
+/* ----------------------------------------
+   A batch holds one request per key, with
+   an id of its own. Returns the index of
+   the new key.
+   ----------------------------------------- */
+int pendingBatch::add(int keyTransID, string key, string value, int need) {
+	if(mt == READ) {
+		reads.emplace_back(keyTransID, timestamp, key, need);
+		return (int) reads.size() - 1;
+	}
+	writes.emplace_back(keyTransID, mt, timestamp, key, value, need);
+	return (int) writes.size() - 1;
+}
+
+bool pendingBatch::isOver(int currTime) {
+	for(size_t i=0; i<size(); i++)
+		if(mt == READ ? !reads[i].isOver(currTime) : !writes[i].isOver(currTime)) return false;
+	return true;
+}
+
+/* ----------------------------------------
+   Take the records of a BATCHREPLY, then
+   answer the keys that have their quorum
+   ----------------------------------------- */
+void MP2Node::setPendBatch(const MessageView &message) {
+	pendingBatch *b = pendB.find(message.transID);
+	string_view records(message.value);
+	Address from = message.fromAddr;
+	batch_op op;
+	if(!b) return;
+	sampleRtt(from, getTimeStamp() - b->getTimestamp());
+	while(Batch::next(records, &op)) {
+		if(op.index < 0 || (size_t) op.index >= b->size()) continue;
+		if(b->getMt() == READ) {
+			pendingRead &r = b->read(op.index);
+			if(r.isDone()) lateReplies++;
+			r.setValue(from, op.value, op.timestamp);
+		} else {
+			pendingWrDl &w = b->write(op.index);
+			if(w.isDone()) lateReplies++;
+			w.setStatus(op.success);
+		}
+	}
+	checkPendBatch(message.transID);
+}
+
+/* ----------------------------------------
+   Answer the keys of a batch that have
+   their quorum or have timed out. The
+   batch stays until every key is over,
+   then its stale replicas are repaired.
+   ----------------------------------------- */
+void MP2Node::checkPendBatch(int transID) {
+	pendingBatch *b = pendB.find(transID);
+	if(!b) return;
+	for(size_t i=0; i<b->size(); i++) {
+		if(b->getMt() == READ) answerRead(b->read(i));
+		else answerWrDl(b->write(i));
+	}
+	if(!b->isOver(getTimeStamp())) return;
+	for(size_t i=0; b->getMt() == READ && i<b->size(); i++)
+		readRepair(b->read(i));
+	pendB.erase(transID);
+}
+
+/* ----------------------------------------
+   Close the pending requests that are due
+   ----------------------------------------- */
+void MP2Node::checkPendTimeouts() {
+	pendTimers.advance(getTimeStamp(), [this](int id) {
+		// every reply of this time unit is in, a hedged read still missing some asks more replicas
+		pendingRead *r = pendR.find(id);
+		if(r && !r->isDone() && r->getSent() < RING_REPLICAS && r->missing() > 0 &&
+		   getTimeStamp() - r->getTimestamp() >= max(1, (int) lround(par->HEDGE_AFTER * QTMOUT)))
+			hedgeRead(*r);
+		checkPendRead(id);
+		checkPendWrDl(id);
+		checkPendBatch(id);
+	});
+}
+
+/* ----------------------------------------
+   Add key, value pair to the new node,
+   with the version it has here. A
+   tombstone goes as a repair, nothing
+   waits for it.
+   ----------------------------------------- */
+void MP2Node::stblznCreate(string key, string value, int timestamp, Node *node) {
+  Message message(++transID, memberNode->addr, value.empty() ? REPAIR : CREATE, key, value, PRIMARY);
+	message.timestamp = timestamp;
+	sendMessage(message, &node->nodeAddress);
+	if(!value.empty()) newPendWrDl(CREATE, key, value)->setStblzn();
+}
+
+/* ----------------------------------------
+   Forget the tombstones older than
+   TOMBSTONE_TTL, by then the replicas that
+   missed the delete had their repair or
+   their hint. One rewritten since waits
+   for its own turn.
+   ----------------------------------------- */
+void MP2Node::purgeTombstones() {
+	string_view found, value;
+	int version;
+	while(!tombstones.empty() && getTimeStamp() - tombstones.front().getTimestamp() >= par->TOMBSTONE_TTL) {
+		string key = tombstones.front().getKey();
+		tombstones.pop();
+		if(store->read(key, found) && Entry::decode(found, &version, &value) && value.empty() &&
+		   getTimeStamp() - version >= par->TOMBSTONE_TTL)
+			store->remove(key);
+	}
+}
+
+/* ----------------------------------------
+   Round trip average of the peers, the
+   first sample sets it
+   ----------------------------------------- */
+void MP2Node::sampleRtt(Address &peer, int rtt) {
+	map<string, double>::iterator it = peerRtt.find(peer.getAddress());
+	if(it == peerRtt.end()) peerRtt[peer.getAddress()] = rtt;
+	else it->second += RTT_WEIGHT * (rtt - it->second);
+}
+
+/* ----------------------------------------
+   Order the replicas of a read: the ones
+   not suspected first, then by round trip
+   average, peers never heard of first.
+   Ties keep the ring order.
+   ----------------------------------------- */
+void MP2Node::rankReplicas(Address *to) {
+	double rank[RING_REPLICAS];
+	map<string, double>::iterator it;
+	int order[RING_REPLICAS] = {0, 1, 2};
+	Address sorted[RING_REPLICAS];
+	for(int i=0; i<RING_REPLICAS; i++) {
+		it = peerRtt.find(to[i].getAddress());
+		rank[i] = (it == peerRtt.end()) ? 0 : it->second;
+		if(hints->isDown(to[i])) rank[i] += QTMOUT * 1000;
+	}
+	stable_sort(order, order + RING_REPLICAS, [&](int a, int b) { return rank[a] < rank[b]; });
+	for(int i=0; i<RING_REPLICAS; i++) sorted[i] = to[order[i]];
+	for(int i=0; i<RING_REPLICAS; i++) to[i] = sorted[i];
+}
+
+/* ----------------------------------------
+   Ask the next replicas of a read that is
+   missing replies, one per missing reply.
+   The read keeps its timeout: a replica
+   whose round trip average would miss it
+   is not asked.
+   ----------------------------------------- */
+void MP2Node::hedgeRead(pendingRead &read) {
+	Message message(read.getTransID(), memberNode->addr, READ, read.getKey());
+	map<string, double>::iterator it;
+	for(int n = read.missing(); n > 0 && read.getSent() < RING_REPLICAS; n--) {
+		it = peerRtt.find(read.getTarget(read.getSent()).getAddress());
+		if(it != peerRtt.end() && getTimeStamp() + it->second > read.getTimestamp() + QTMOUT) break;
+		Address &to = read.hedge(getTimeStamp());
+		sendMessage(message, &to);
+		readMsgs++;
+		hedges++;
+	}
+}
+
+/* ----------------------------------------
+   Send the newest version of a read key to
+   the replicas that returned an older one,
+   the replies are not waited for
+   ----------------------------------------- */
+void MP2Node::readRepair(pendingRead &read) {
+	ReplicaSet node;
+	int n = read.newest();
+	if(n < 0 || !ring.findReplicas(hashFunction(read.getKey()), node)) return;
+	Message message(++transID, memberNode->addr, REPAIR, read.getKey(), read.getValue(), PRIMARY);
+	message.timestamp = read.getVersion();
+	for(int i=0; i<read.getReplies(); i++) {
+		if(!read.isStale(i)) continue;
+		for(int j=0; j<RING_REPLICAS; j++) {
+			if(ring.at(node[j]).nodeAddress == read.getFrom(i)) {
+				message.replica = static_cast<ReplicaType>(j);
+				sendMessage(message, &read.getFrom(i));
+				repairsSent++;
 				break;
+			}
 		}
 	}
 }
 
-void MP2Node::checkPendWrDl() {
-  vector<pendingWrDl>::iterator wit;
-	for(wit=pendCUD.begin(); wit!=pendCUD.end(); ) {
-		switch(wit->gotQuorum(getTimeStamp())) {
-			case QSUCCESS:
-			  switch(wit->getMt()) {
-					case CREATE:
-						log->logCreateSuccess(&memberNode->addr, true, wit->getTransID(), wit->getKey(), wit->getValue());
-						break;
-					case UPDATE:
-						log->logUpdateSuccess(&memberNode->addr, true, wit->getTransID(), wit->getKey(), wit->getValue());
-						break;
-					case DELETE:
-						log->logDeleteSuccess(&memberNode->addr, true, wit->getTransID(), wit->getKey());
-						break;
-					default:
-						break;
-				}
-				wit = pendCUD.erase(wit);
+/* ----------------------------------------
+   Send a write to a replica, or keep it as
+   a hint if the replica is down. Returns
+   the number of replies to expect.
+   ----------------------------------------- */
+int MP2Node::sendWrite(Message &message, Address *toAddr) {
+	if(hints->isDown(*toAddr)) {
+		hints->add(*toAddr, message.type, message.key, message.value, message.timestamp);
+		return 0;
+	}
+	sendMessage(message, toAddr);
+	return 1;
+}
+
+/* ----------------------------------------
+   Deliver a batch of the hints of the
+   replicas that are back. The replies are
+   not waited for, hints count for no quorum.
+   Creates and updates go as repairs, which
+   never overwrite a newer version.
+   ----------------------------------------- */
+void MP2Node::replayHints() {
+	hints->replay([this](Address &to, MessageType type, string_view key, string_view value, int timestamp) {
+		Message message(++transID, memberNode->addr, (type == DELETE) ? DELETE : REPAIR, string(key), string(value), PRIMARY);
+		message.timestamp = timestamp;
+		sendMessage(message, &to);
+	});
+}
+
+/* ----------------------------------------
+   Bytes of records that fit in a message
+   ----------------------------------------- */
+int MP2Node::batchRoom() {
+	return min((int) sizeof(msgBff), par->MAX_MSG_SIZE - (int) sizeof(en_msg)) - MSG_HDRSZ - BATCH_SLACK;
+}
+
+/* ----------------------------------------
+   Group the keys by replica: the records
+   for each replica go in BATCH messages of
+   up to batchRoom() bytes, the writes for
+   a replica that is down become hints. A
+   key that is bigger than the room goes in
+   a message of its own.
+   ----------------------------------------- */
+void MP2Node::sendBatch(MessageType mt, const vector< pair<string, string> > &kv) {
+	ReplicaSet node;
+	pendingBatch batch(++transID, mt, getTimeStamp());
+	// records waiting for each replica
+	vector< pair<Address, string> > out;
+	size_t d;
+	int sent, id = transID;
+	batch_op op;
+	Message message(id, memberNode->addr, BATCH, "", "");
+	for(size_t i=0; i<kv.size(); i++) {
+		if(!ring.findReplicas(hashFunction(kv[i].first), node)) continue;
+		++transID;
+		op = batch_op{batch.add(transID, kv[i].first, kv[i].second, (mt == READ) ? par->READ_QUORUM : par->WRITE_QUORUM),
+				transID, mt, PRIMARY, false, getTimeStamp(), kv[i].first, kv[i].second};
+		sent = 0;
+		for(int j=0; j<RING_REPLICAS; j++) {
+			Address &to = ring.at(node[j]).nodeAddress;
+			op.replica = static_cast<ReplicaType>(j);
+			if(mt != READ && hints->isDown(to)) {
+				hints->add(to, mt, op.key, op.value, op.timestamp);
+				continue;
+			}
+			for(d = 0; d < out.size() && !(out[d].first == to); d++);
+			if(d == out.size()) out.emplace_back(to, "");
+			if(!out[d].second.empty() && out[d].second.size() + Batch::recordSize(op) > (size_t) batchRoom()) {
+				message.value.swap(out[d].second);
+				sendMessage(message, &to);
+				out[d].second.clear();
+				batchMsgs++;
+			}
+			Batch::append(out[d].second, op);
+			batchRecords++;
+			sent++;
+		}
+		if(mt != READ) batch.write(op.index).setExpected(sent);
+	}
+	if(batch.size() == 0) return;
+	for(d = 0; d < out.size(); d++) {
+		if(out[d].second.empty()) continue;
+		message.value.swap(out[d].second);
+		sendMessage(message, &out[d].first);
+		batchMsgs++;
+	}
+	pendTimers.schedule(id, getTimeStamp() + QTMOUT);
+	pendB.insert(id, batch);
+}
+
+/* ----------------------------------------
+   Server side of a BATCH: run the request
+   of each record as if it came on its own,
+   and reply with their outcomes, in as
+   many BATCHREPLY messages as they need
+   ----------------------------------------- */
+void MP2Node::serveBatch(const MessageView &message) {
+	string_view records(message.value), value;
+	string replies;
+	batch_op op;
+	Address toAddr = message.fromAddr;
+	MessageView out = message;
+	out.fromAddr = memberNode->addr;
+	out.type = BATCHREPLY;
+	out.key = string_view();
+	while(Batch::next(records, &op)) {
+		value = string_view();
+		switch(op.type) {
+			case CREATE:
+				op.success = createKeyValue(op.transID, op.key, op.value, op.replica, op.timestamp);
 				break;
-			case QFAIL:
-				switch(wit->getMt()) {
-					case CREATE:
-						log->logCreateFail(&memberNode->addr, true, wit->getTransID(), wit->getKey(), wit->getValue());
-						break;
-					case UPDATE:
-						log->logUpdateFail(&memberNode->addr, true, wit->getTransID(), wit->getKey(), wit->getValue());
-						break;
-					case DELETE:
-						log->logDeleteFail(&memberNode->addr, true, wit->getTransID(), wit->getKey());
-						break;
-					default:
-						break;
-				}
-				wit = pendCUD.erase(wit);
+			case UPDATE:
+				op.success = updateKeyValue(op.transID, op.key, op.value, op.replica, op.timestamp);
 				break;
-			case QWAIT:
-			  wit++;
+			case READ:
+				op.success = readKey(op.transID, op.key, op.timestamp, value);
+				break;
+			case DELETE:
+				op.success = deletekey(op.transID, op.key, op.replica, op.timestamp);
 				break;
+			default:
+				continue;
+		}
+		op.key = string_view();
+		op.value = value;
+		if(!replies.empty() && replies.size() + Batch::recordSize(op) > (size_t) batchRoom()) {
+			out.value = replies;
+			reply(out, toAddr);
+			replies.clear();
 		}
+		Batch::append(replies, op);
 	}
+	if(replies.empty()) return;
+	out.value = replies;
+	reply(out, toAddr);
 }
 
-/* ------------------------------------------------------------------
-  get new nodes corresponding to a given key
----------------------------------------------------------------------*/
-vector<Node> MP2Node::findNewNodes(string key, vector<Node>& newRing) {
-	size_t pos = hashFunction(key);
-	vector<Node> addr_vec;
-	if (newRing.size() >= 3) {
-		// if pos <= min || pos > max, the leader is the min
-		if (pos <= newRing.at(0).getHashCode() || pos > newRing.at(newRing.size()-1).getHashCode()) {
-			addr_vec.emplace_back(newRing.at(0));
-			addr_vec.emplace_back(newRing.at(1));
-			addr_vec.emplace_back(newRing.at(2));
-		}
-		else {
-			// go through the newRing until pos <= node
-			for (int i = 1; i < (int) newRing.size(); i++){
-				Node addr = newRing.at(i);
-				if (pos <= addr.getHashCode()) {
-					addr_vec.emplace_back(addr);
-					addr_vec.emplace_back(newRing.at((i+1)%newRing.size()));
-					addr_vec.emplace_back(newRing.at((i+2)%newRing.size()));
-					break;
-				}
+/* ----------------------------------------
+   Turn the reply to a write into a failure,
+   the reply to a read is left as it is
+   ----------------------------------------- */
+void MP2Node::failReply(Message &message) {
+	string_view records;
+	string failed;
+	batch_op op;
+	switch(message.type) {
+		case REPLY:
+			message.success = false;
+			break;
+		case BATCHREPLY:
+			records = message.value;
+			while(Batch::next(records, &op)) {
+				if(op.type != READ) op.success = false;
+				Batch::append(failed, op);
 			}
-		}
+			message.value.swap(failed);
+			break;
+		default:
+			break;
 	}
-	return addr_vec;
 }
 
 /* ----------------------------------------
-   Is this Node in the List?
+   Send the reply to a request, or hold it
+   until the write it acks is committed
    ----------------------------------------- */
-bool MP2Node::isListed(Address addr, vector<Node> nList) {
-	vector<Node>::iterator it;
-	bool r = false;
-	for(it = nList.begin(); it != nList.end() && !r; it++)
-	  r = (it->nodeAddress == addr);
-	return r;
+void MP2Node::reply(const MessageView &message, Address &toAddr) {
+	if(store->logging() && par->WAL_GROUP) deferred.emplace_back(Message(message), toAddr);
+	else sendMessage(message, &toAddr);
 }
 
 /* ----------------------------------------
-   Add key, value pair to the new node
+   Serialize a message and send it
    ----------------------------------------- */
-void MP2Node::stblznCreate(string key, string value, Node *node) {
-	string msgBff;
-  Message message(++transID, memberNode->addr, CREATE, key, value, PRIMARY);
-	msgBff = message.toString();
-	emulNet->ENsend(&memberNode->addr, &node->nodeAddress, msgBff);
-	pendCUD.emplace_back(transID, CREATE, par->getcurrtime(), key, value);
-	pendCUD.back().setStblzn();
+void MP2Node::sendMessage(Message &message, Address *toAddr) {
+	sendMessage(message.view(), toAddr);
+}
+
+void MP2Node::sendMessage(const MessageView &message, Address *toAddr) {
+	int n = Message::encode(message, msgBff, sizeof(msgBff));
+	if(n < 0)
+		emulNet->ENsend(&memberNode->addr, toAddr, Message::toString(message));
+	else
+		emulNet->ENsend(&memberNode->addr, toAddr, msgBff, n);
+}
+
+/* ----------------------------------------
+   Storage statistics to the stats log
+   ----------------------------------------- */
+void MP2Node::logStorageStats() {
+	store->logStats(log, &memberNode->addr);
+	if(par->HINTS) hints->logStats(log, &memberNode->addr);
+	log->LOG(&memberNode->addr, "#STATSLOG# read repairs sent %ld applied %ld", repairsSent, repairsApplied);
+	if(batchMsgs > 0) log->LOG(&memberNode->addr, "#STATSLOG# batches sent %ld records %ld", batchMsgs, batchRecords);
 }
@@ -13,63 +13,150 @@
 #include "stdincludes.h"
 #include "EmulNet.h"
 #include "Node.h"
-#include "HashTable.h"
+#include "Ring.h"
+#include "KVStore.h"
+#include "HintStore.h"
 #include "Log.h"
 #include "Params.h"
 #include "Message.h"
+#include "Batch.h"
 #include "Queue.h"
+#include "TransTable.h"
+#include "TimerWheel.h"
 
 #define QTMOUT 3
 #define DELKEYTMOUT 4
+#define MP2MSGSZ 4096
+// weight of a new sample in the round trip average of a peer
+#define RTT_WEIGHT 0.25
+// room left in a message for the header and the text format fields around the records
+#define BATCH_SLACK 64
 
 enum QuorumStat { QFAIL, QWAIT, QSUCCESS };
 
 class pendingRead {
 private:
-	int transID, q, timestamp;
+	// replies needed to answer, READ_QUORUM
+	int transID, q, timestamp, need;
+	// the replies: replica, value and its version. A delete is "" with its version,
+	// a replica without the key replies "" with version 0
+	Address from[3];
+	int version[3] = {0};
 	string key, value[3] = {""};
+	// replicas in the order they are asked, the first nsent were, at sentAt
+	Address to[3];
+	int sentAt[3] = {0}, nsent;
+	// the client was answered, the request only waits for the late replies
+	bool done;
 public:
-	pendingRead(int transID, int timestamp, string key) {
+	pendingRead(): transID(-1), q(0), timestamp(0), need(2), nsent(3), done(false) {}
+	pendingRead(int transID, int timestamp, string key, int need) {
 		this->transID = transID;
 		this->timestamp = timestamp;
 		this->key = key;
+		this->need = need;
 		q = 0;
+		nsent = 3;
+		done = false;
 	}
 	~pendingRead() {};
 	int getTransID() { return transID; };
-	int setValue(string v) { value[q++] = v; return q; };
+	int setValue(Address &from, string_view v, int version);
 	QuorumStat gotQuorum(int currTime);
+	bool isDone() { return done; };
+	void setDone() { done = true; };
+	bool isOver(int currTime) { return q == nsent || (currTime - timestamp) >= QTMOUT; };
+	int getReplies() { return q; };
+	int getTimestamp() { return timestamp; };
+	void setTargets(Address *to, int nsent);
+	int getSent() { return nsent; };
+	Address &getTarget(int i) { return to[i]; };
+	int getSentAt(int i) { return sentAt[i]; };
+	bool hasReplied(Address &addr);
+	// asks the next replica, within the timeout of the request
+	Address &hedge(int currTime) { sentAt[nsent] = currTime; return to[nsent++]; };
+	int missing() { return need - q; };
+	Address &getFrom(int i) { return from[i]; };
+	bool has(int i) { return value[i] != "" || version[i] > 0; };
+	int newest();
+	bool isStale(int i);
 	string getKey() { return key; };
 	string getValue();
+	int getVersion();
 };
 
 class pendingWrDl {
 private:
-	int transID, q, timestamp;
+	// replies expected, replicas that are down get a hint instead, and successes
+	// needed, WRITE_QUORUM
+	int transID, q, timestamp, expected, need;
 	MessageType mt;
 	bool status[3] = {false}, stblzn;
+	// the client was answered, the request only waits for the late replies
+	bool done;
 	string key, value;
 public:
-	pendingWrDl(int transID, MessageType mt, int timestamp, string key, string value) {
+	pendingWrDl(): transID(-1), q(0), timestamp(0), expected(3), need(2), mt(CREATE), stblzn(false), done(false) {}
+	pendingWrDl(int transID, MessageType mt, int timestamp, string key, string value, int need) {
 		this->transID = transID;
 		this->mt = mt;
 		this->timestamp = timestamp;
 		this->key = key;
 		this->value = value;
+		this->need = need;
 		q = 0;
+		expected = 3;
 		stblzn = false;
+		done = false;
 	};
 	~pendingWrDl() {};
 	int getTransID() { return transID; };
-	int setStatus(bool v) { status[q++] = v; return q; };
+	int setStatus(bool v) { if(q < 3) status[q++] = v; return q; };
 	QuorumStat gotQuorum(int currTime);
+	bool isDone() { return done; };
+	void setDone() { done = true; };
+	bool isOver(int currTime) { return q >= expected || (currTime - timestamp) >= QTMOUT; };
+	int getTimestamp() { return timestamp; };
 	bool isStblzn() { return stblzn; };
 	void setStblzn() { stblzn = true; };
+	void setExpected(int n) { expected = n; };
 	MessageType getMt() { return mt; };
 	string getKey() { return key; };
 	string getValue() { return value; };
 };
 
+/**
+ * CLASS NAME: pendingBatch
+ *
+ * DESCRIPTION: A multi-key request: one pending read, or create or delete, per key,
+ * 				each answered on its own quorum and logged with its own transID. The
+ * 				replies of a replica come in BATCHREPLY messages, their records name
+ * 				the key by its index.
+ */
+class pendingBatch {
+private:
+	int transID, timestamp;
+	MessageType mt;
+	vector<pendingRead> reads;
+	vector<pendingWrDl> writes;
+public:
+	pendingBatch(): transID(-1), timestamp(0), mt(CREATE) {}
+	pendingBatch(int transID, MessageType mt, int timestamp) {
+		this->transID = transID;
+		this->mt = mt;
+		this->timestamp = timestamp;
+	};
+	~pendingBatch() {};
+	int getTransID() { return transID; };
+	int getTimestamp() { return timestamp; };
+	MessageType getMt() { return mt; };
+	size_t size() { return (mt == READ) ? reads.size() : writes.size(); };
+	int add(int keyTransID, string key, string value, int need);
+	pendingRead &read(size_t i) { return reads[i]; };
+	pendingWrDl &write(size_t i) { return writes[i]; };
+	bool isOver(int currTime);
+};
+
 class TbDelKey {
 private:
 	string key;
@@ -78,6 +165,7 @@ public:
 	TbDelKey(string key, int timestamp) { this->key = key; this->timestamp = timestamp; };
 	~TbDelKey() {};
 	string getKey() { return key; };
+	int getTimestamp() { return timestamp; };
 	bool delReady(int currTime) { return ((currTime - timestamp) > DELKEYTMOUT); };
 };
 
@@ -98,9 +186,34 @@ private:
 	// Vector holding the previous two neighbors in the ring whose replicas I have
 	vector<Node> haveReplicasOf;
 	// Ring
-	vector<Node> ring;
-	// Hash Table
-	HashTable *ht;
+	Ring ring;
+	// Replica store: memtable, write-ahead log and table files
+	KVStore *store;
+	// writes kept for the replicas that are down
+	HintStore *hints;
+	// replies held until the writes they ack are committed to the log
+	vector< pair<Message, Address> > deferred;
+	// read repair statistics: repairs sent as coordinator, applied as replica
+	long repairsSent, repairsApplied;
+	// completion time in ticks of the client requests, by type: a histogram
+	vector<long> latency[DELETE + 1];
+	// replies that came after their request was answered
+	long lateReplies;
+	// round trip average of each peer, by address
+	map<string, double> peerRtt;
+	// read traffic: client reads, READ messages sent, hedges among them, replies
+	long reads, readMsgs, hedges, readReplies;
+	void answered(MessageType mt, int since);
+	void sampleRtt(Address &peer, int rtt);
+	void rankReplicas(Address *to);
+	void hedgeRead(pendingRead &read);
+	// batched requests: BATCH messages sent and the key records they held
+	long batchMsgs, batchRecords;
+	int batchRoom();
+	void sendBatch(MessageType mt, const vector< pair<string, string> > &kv);
+	void serveBatch(const MessageView &message);
+	void reply(const MessageView &message, Address &toAddr);
+	void failReply(Message &message);
 	// Member representing this member
 	Member *memberNode;
 	// Params object
@@ -109,17 +222,43 @@ private:
 	EmulNet *emulNet;
 	// Object of Log
 	Log *log;
+	// Outgoing message buffer
+	char msgBff[MP2MSGSZ];
+	// Entry written to the store, kept to reuse its capacity
+	string entryBff;
 
 public:
 	MP2Node(Member *memberNode, Params *par, EmulNet *emulNet, Log *log, Address *addressOfMember);
 	Member *getMemberNode() {
 		return this->memberNode;
 	}
+	Ring &getRing() {
+		return this->ring;
+	}
+	unsigned long keyCount() {
+		return store->size();
+	}
+	unsigned long storeBytes() {
+		return store->memoryBytes();
+	}
+	const vector<long> &getLatency(MessageType mt) {
+		return latency[mt];
+	}
+	long getLateReplies() {
+		return lateReplies;
+	}
+	void getReadTraffic(long &reads, long &readMsgs, long &hedges, long &readReplies) {
+		reads = this->reads;
+		readMsgs = this->readMsgs;
+		hedges = this->hedges;
+		readReplies = this->readReplies;
+	}
+	void logStorageStats();
 
 	// ring functionalities
 	void updateRing();
 	vector<Node> getMembershipList();
-	size_t hashFunction(string key);
+	size_t hashFunction(string_view key);
 	void findNeighbors();
 
 	// client side CRUD APIs
@@ -127,6 +266,10 @@ public:
 	void clientRead(string key);
 	void clientUpdate(string key, string value);
 	void clientDelete(string key);
+	// batched client side APIs, one message per replica for many keys
+	void multiGet(const vector<string> &keys);
+	void multiPut(const map<string, string> &pairs);
+	void multiDelete(const vector<string> &keys);
 
 	// receive messages from Emulnet
 	bool recvLoop();
@@ -142,29 +285,45 @@ public:
 	vector<Node> findNodes(string key);
 
 	// server
-	bool createKeyValue(int transID, string key, string value, ReplicaType replica);
-	string readKey(int transID, string key);
-	bool updateKeyValue(int transID, string key, string value, ReplicaType replica);
-	bool deletekey(int transID, string key);
+	bool createKeyValue(int transID, string_view key, string_view value, ReplicaType replica, int timestamp);
+	bool readKey(int transID, string_view key, int &timestamp, string_view &value);
+	bool updateKeyValue(int transID, string_view key, string_view value, ReplicaType replica, int timestamp);
+	bool repairKey(string_view key, string_view value, ReplicaType replica, int timestamp);
+	bool deletekey(int transID, string_view key, ReplicaType replica, int timestamp);
 
 	// stabilization protocol - handle multiple failures
 	void stabilizationProtocol();
 
 	// My public variables & methods
 	int transID;
-	vector<pendingRead> pendR;
-	vector<pendingWrDl> pendCUD;
+	// requests waiting for replies, keyed by transID
+	TransTable<pendingRead> pendR;
+	TransTable<pendingWrDl> pendCUD;
+	TransTable<pendingBatch> pendB;
+	// their timeouts
+	TimerWheel<int> pendTimers;
 	vector<TbDelKey> tbDelKey;
+	// tombstones in the store, in the order they were written
+	queue<TbDelKey> tombstones;
 	int getTimeStamp() { return par->getcurrtime(); };
-	vector<pendingRead>::iterator findPendRead(int transID);
-	vector<pendingWrDl>::iterator findPendWrDl(int transID);
-	void setPendRead(int transID, string value);
-	void setPendWrDl(int transID, bool st);
-	void checkPendRead();
-	void checkPendWrDl();
-	vector<Node> findNewNodes(string key, vector<Node>& newRing);
-	bool isListed(Address addr, vector<Node> nList);
-	void stblznCreate(string key, string value, Node *node);
+	pendingRead *newPendRead(string key);
+	pendingWrDl *newPendWrDl(MessageType mt, string key, string value);
+	void setPendRead(int transID, Address &from, string_view value, int version);
+	void setPendWrDl(int transID, Address &from, bool st);
+	void checkPendRead(int transID);
+	void checkPendWrDl(int transID);
+	void setPendBatch(const MessageView &message);
+	void checkPendBatch(int transID);
+	bool answerRead(pendingRead &read);
+	bool answerWrDl(pendingWrDl &write);
+	void checkPendTimeouts();
+	void stblznCreate(string key, string value, int timestamp, Node *node);
+	void readRepair(pendingRead &read);
+	void purgeTombstones();
+	int sendWrite(Message &message, Address *toAddr);
+	void replayHints();
+	void sendMessage(Message &message, Address *toAddr);
+	void sendMessage(const MessageView &message, Address *toAddr);
 
   // Destructor
 	~MP2Node();
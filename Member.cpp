@@ -11,6 +11,31 @@
  */
 q_elt::q_elt(void *elt, int size): elt(elt), size(size) {}
 
+/**
+ * Copy constructor
+ */
+q_elt::q_elt(const q_elt &anotherElt): elt(anotherElt.elt), size(anotherElt.size) {
+	MsgPool::retain(elt);
+}
+
+/**
+ * Assignment operator overloading
+ */
+q_elt& q_elt::operator =(const q_elt &anotherElt) {
+	MsgPool::retain(anotherElt.elt);
+	MsgPool::release(elt);
+	elt = anotherElt.elt;
+	size = anotherElt.size;
+	return *this;
+}
+
+/**
+ * Destructor
+ */
+q_elt::~q_elt() {
+	MsgPool::release(elt);
+}
+
 /**
  * Copy constructor
  */
@@ -153,6 +178,7 @@ Member::Member(const Member &anotherMember) {
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
 	this->myPos = anotherMember.myPos;
+	this->ringEvents = anotherMember.ringEvents;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
 }
@@ -171,6 +197,7 @@ Member& Member::operator =(const Member& anotherMember) {
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
 	this->myPos = anotherMember.myPos;
+	this->ringEvents = anotherMember.ringEvents;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
 	return *this;
@@ -8,17 +8,23 @@
 #define MEMBER_H_
 
 #include "stdincludes.h"
+#include "MsgPool.h"
 
 /**
  * CLASS NAME: q_elt
  *
- * DESCRIPTION: Entry in the queue
+ * DESCRIPTION: Entry in the queue. It owns a reference to a MsgPool buffer,
+ * 				the buffer goes back to the pool when the last entry referring to it is gone.
  */
 class q_elt {
 public:
 	void *elt;
 	int size;
+	// takes over the reference held by the caller
 	q_elt(void *elt, int size);
+	q_elt(const q_elt &anotherElt);
+	q_elt& operator =(const q_elt &anotherElt);
+	virtual ~q_elt();
 };
 
 /**
@@ -80,6 +86,23 @@ public:
 	void settimestamp(long timestamp);
 };
 
+/**
+ * Membership changes notified to the KV store ring. A suspected member stays in
+ * the ring until it leaves, RING_ALIVE clears the suspicion.
+ */
+enum RingEventType { RING_JOIN, RING_LEAVE, RING_RESET, RING_SUSPECT, RING_ALIVE };
+
+/**
+ * STRUCT NAME: ring_event
+ *
+ * DESCRIPTION: Change of the membership list, queued by the membership protocol
+ * 				and consumed by the ring of the KV store
+ */
+typedef struct ring_event {
+	RingEventType type;
+	Address addr;
+} ring_event;
+
 /**
  * CLASS NAME: Member
  *
@@ -108,6 +131,8 @@ public:
 	vector<MemberListEntry> memberList;
 	// My position in the membership table
 	vector<MemberListEntry>::iterator myPos;
+	// Membership changes not yet applied to the ring
+	vector<ring_event> ringEvents;
 	// Queue for failure detection messages
 	queue<q_elt> mp1q;
 	// Queue for KVstore messages
@@ -5,54 +5,187 @@
  **********************************/
 #include "Message.h"
 
+bool Message::textFormat = false;
+
 /**
- * Constructor
+ * FUNCTION NAME: parseInt
+ *
+ * DESCRIPTION: Parses a decimal integer that spans the whole view
  */
-// transID::fromAddr::CREATE::key::value::ReplicaType
-// transID::fromAddr::READ::key
-// transID::fromAddr::UPDATE::key::value::ReplicaType
-// transID::fromAddr::DELETE::key
-// transID::fromAddr::REPLY::sucess
-// transID::fromAddr::READREPLY::value
-Message::Message(string message){
-	this->delimiter = "::";
-	vector<string> tuple;
-	size_t pos = message.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = message.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + 2;
-		pos = message.find(delimiter, start);
+static bool parseInt(string_view s, int *v) {
+	size_t i = 0;
+	bool neg = false;
+	long n = 0;
+	if ( s.empty() ) {
+		return false;
 	}
-	tuple.push_back(message.substr(start));
+	if ( s[0] == '-' ) {
+		neg = true;
+		i++;
+	}
+	if ( i == s.size() ) {
+		return false;
+	}
+	for ( ; i < s.size(); i++ ) {
+		if ( s[i] < '0' || s[i] > '9' ) {
+			return false;
+		}
+		n = n * 10 + (s[i] - '0');
+	}
+	*v = (int) (neg ? -n : n);
+	return true;
+}
 
-	transID = stoi(tuple.at(0));
-	Address addr(tuple.at(1));
-	fromAddr = addr;
-	type = static_cast<MessageType>(stoi(tuple.at(2)));
-	switch(type){
+/**
+ * FUNCTION NAME: parse
+ *
+ * DESCRIPTION: Parses a message from a receive buffer. Binary messages start with MSG_MAGIC:
+ * 				magic(1) type(1) replica(1) success(1) transID(4) fromAddr(6) keylen(2) valuelen(4) timestamp(4) key value
+ * 				Anything else is taken as the text format:
+ * 				transID::fromAddr::CREATE::key::value::ReplicaType::timestamp
+ * 				transID::fromAddr::READ::key
+ * 				transID::fromAddr::UPDATE::key::value::ReplicaType::timestamp
+ * 				transID::fromAddr::DELETE::key::timestamp
+ * 				transID::fromAddr::REPLY::sucess
+ * 				transID::fromAddr::READREPLY::timestamp::value
+ * 				transID::fromAddr::REPAIR::key::value::ReplicaType::timestamp
+ * 				transID::fromAddr::BATCH::records
+ * 				transID::fromAddr::BATCHREPLY::records
+ *
+ * RETURNS:
+ * true if the message is well formed and of a known type
+ */
+bool Message::parse(const char *data, int size, MessageView *view) {
+	view->replica = PRIMARY;
+	view->success = false;
+	view->timestamp = 0;
+	view->key = string_view();
+	view->value = string_view();
+
+	if ( size >= MSG_HDRSZ && data[0] == MSG_MAGIC ) {
+		unsigned short klen;
+		unsigned int vlen;
+		if ( data[1] < CREATE || data[1] > BATCHREPLY ) {
+			return false;
+		}
+		view->type = static_cast<MessageType>(data[1]);
+		view->replica = static_cast<ReplicaType>(data[2]);
+		view->success = (data[3] != 0);
+		memcpy(&view->transID, &data[4], sizeof(int));
+		memcpy(view->fromAddr.addr, &data[8], sizeof(view->fromAddr.addr));
+		memcpy(&klen, &data[14], sizeof(klen));
+		memcpy(&vlen, &data[16], sizeof(vlen));
+		memcpy(&view->timestamp, &data[20], sizeof(int));
+		if ( (size_t) MSG_HDRSZ + klen + vlen > (size_t) size ) {
+			return false;
+		}
+		view->key = string_view(data + MSG_HDRSZ, klen);
+		view->value = string_view(data + MSG_HDRSZ + klen, vlen);
+		return true;
+	}
+
+	string_view msg(data, size), tuple[7];
+	size_t ntuple = 0, start = 0, pos;
+	int v, id, port;
+	while ( ntuple < 6 && (pos = msg.find("::", start)) != string_view::npos ) {
+		tuple[ntuple++] = msg.substr(start, pos - start);
+		start = pos + 2;
+	}
+	tuple[ntuple++] = msg.substr(start);
+	if ( ntuple < 4 || !parseInt(tuple[0], &view->transID) || !parseInt(tuple[2], &v) ) {
+		return false;
+	}
+	pos = tuple[1].find(':');
+	if ( pos == string_view::npos || !parseInt(tuple[1].substr(0, pos), &id) || !parseInt(tuple[1].substr(pos + 1), &port) ) {
+		return false;
+	}
+	short sport = (short) port;
+	memcpy(&view->fromAddr.addr[0], &id, sizeof(int));
+	memcpy(&view->fromAddr.addr[4], &sport, sizeof(short));
+	if ( v < CREATE || v > BATCHREPLY ) {
+		return false;
+	}
+	view->type = static_cast<MessageType>(v);
+	switch(view->type){
 		case CREATE:
 		case UPDATE:
-			key = tuple.at(3);
-			value = tuple.at(4);
-			if (tuple.size() > 5)
-				replica = static_cast<ReplicaType>(stoi(tuple.at(5)));
+		case REPAIR:
+			if ( ntuple < 5 ) {
+				return false;
+			}
+			view->key = tuple[3];
+			view->value = tuple[4];
+			if ( ntuple > 5 && parseInt(tuple[5], &v) )
+				view->replica = static_cast<ReplicaType>(v);
+			if ( ntuple > 6 && parseInt(tuple[6], &v) )
+				view->timestamp = v;
 			break;
 		case READ:
+			view->key = tuple[3];
+			break;
 		case DELETE:
-			key = tuple.at(3);
+			view->key = tuple[3];
+			if ( ntuple > 4 && parseInt(tuple[4], &v) )
+				view->timestamp = v;
 			break;
 		case REPLY:
-			if (tuple.at(3) == "1")
-				success = true;
-			else
-				success = false;
+			view->success = (tuple[3] == "1");
 			break;
 		case READREPLY:
-			value = tuple.at(3);
+			// the value is last, it may hold the delimiter
+			if ( ntuple > 4 && parseInt(tuple[3], &view->timestamp) ) {
+				view->value = msg.substr(tuple[4].data() - msg.data());
+			}
+			else {
+				view->value = tuple[3];
+			}
+			break;
+		case BATCH:
+		case BATCHREPLY:
+			// binary records, they may hold the delimiter
+			view->value = msg.substr(tuple[3].data() - msg.data());
 			break;
 	}
+	return true;
+}
+
+/**
+ * Constructor
+ */
+Message::Message(string message): Message(message.data(), (int) message.size()) {}
+
+/**
+ * Constructor
+ */
+// parse a message straight from a receive buffer
+// a malformed message comes out as a failed REPLY with transID -1, which nobody waits for
+Message::Message(const char *data, int size){
+	MessageView view;
+	this->delimiter = "::";
+	if ( !parse(data, size, &view) ) {
+		view.transID = -1;
+		view.type = REPLY;
+		view.replica = PRIMARY;
+		view.success = false;
+		view.fromAddr.init();
+	}
+	*this = Message(view);
+}
+
+/**
+ * Constructor
+ */
+// copy a parsed message out of the buffer it points into
+Message::Message(const MessageView &view){
+	this->delimiter = "::";
+	transID = view.transID;
+	fromAddr = view.fromAddr;
+	type = view.type;
+	replica = view.replica;
+	success = view.success;
+	timestamp = view.timestamp;
+	key.assign(view.key.data(), view.key.size());
+	value.assign(view.value.data(), view.value.size());
 }
 
 /**
@@ -61,6 +194,7 @@ Message::Message(string message){
 // construct a create or update message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -78,6 +212,7 @@ Message::Message(const Message& anotherMessage) {
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
+	this->timestamp = anotherMessage.timestamp;
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
@@ -88,6 +223,7 @@ Message::Message(const Message& anotherMessage) {
  */
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -101,6 +237,7 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct a read or delete message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -113,6 +250,7 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct reply message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _success){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -125,41 +263,137 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _succe
 // construct read reply message
 Message::Message(int _transID, Address _fromAddr, string _value){
 	this->delimiter = "::";
+	timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = READREPLY;
 	value = _value;
 }
 
+/**
+ * FUNCTION NAME: view
+ *
+ * DESCRIPTION: The fields of the message, key and value point into it
+ */
+MessageView Message::view() {
+	MessageView view;
+	view.transID = transID;
+	view.fromAddr = fromAddr;
+	view.type = type;
+	view.replica = replica;
+	view.success = success;
+	view.timestamp = timestamp;
+	view.key = key;
+	view.value = value;
+	return view;
+}
+
 /**
  * FUNCTION NAME: toString
  *
  * DESCRIPTION: Serialized Message in string format
  */
 string Message::toString(){
-	string message = to_string(transID) + delimiter + fromAddr.getAddress() + delimiter + to_string(type) + delimiter;
-	switch(type){
+	return toString(view());
+}
+
+string Message::toString(const MessageView &view){
+	if ( !textFormat ) {
+		string message(MSG_HDRSZ + view.key.size() + view.value.size(), '\0');
+		encode(view, &message[0], (int) message.size());
+		return message;
+	}
+	string delimiter = "::";
+	Address fromAddr = view.fromAddr;
+	string message = to_string(view.transID) + delimiter + fromAddr.getAddress() + delimiter + to_string(view.type) + delimiter;
+	switch(view.type){
 		case CREATE:
 		case UPDATE:
-			message += key + delimiter + value + delimiter + to_string(replica);
+		case REPAIR:
+			message.append(view.key).append(delimiter).append(view.value);
+			message += delimiter + to_string(view.replica) + delimiter + to_string(view.timestamp);
 			break;
 		case READ:
+			message.append(view.key);
+			break;
 		case DELETE:
-			message += key;
+			message.append(view.key);
+			message += delimiter + to_string(view.timestamp);
 			break;
 		case REPLY:
-			if (success)
+			if (view.success)
 				message += "1";
 			else
 				message += "0";
 			break;
 		case READREPLY:
-			message += value;
+			message += to_string(view.timestamp) + delimiter;
+			message.append(view.value);
+			break;
+		case BATCH:
+		case BATCHREPLY:
+			message.append(view.value);
 			break;
 	}
 	return message;
 }
 
+/**
+ * FUNCTION NAME: encodedSize
+ *
+ * DESCRIPTION: Number of bytes of the serialized message
+ */
+int Message::encodedSize() {
+	if ( textFormat ) {
+		return (int) toString().size();
+	}
+	return MSG_HDRSZ + (int) key.size() + (int) value.size();
+}
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Serializes the message into buf
+ *
+ * RETURNS:
+ * number of bytes written, -1 if buf is too small
+ */
+int Message::encode(char *buf, int size) {
+	return encode(view(), buf, size);
+}
+
+int Message::encode(const MessageView &view, char *buf, int size) {
+	int n;
+	MessageType type = view.type;
+	if ( textFormat ) {
+		string message = toString(view);
+		n = (int) message.size();
+		if ( n > size ) {
+			return -1;
+		}
+		memcpy(buf, message.data(), n);
+		return n;
+	}
+	n = MSG_HDRSZ + (int) view.key.size() + (int) view.value.size();
+	if ( n > size || view.key.size() > 0xFFFF ) {
+		return -1;
+	}
+	unsigned short klen = (unsigned short) view.key.size();
+	unsigned int vlen = (unsigned int) view.value.size();
+	buf[0] = MSG_MAGIC;
+	buf[1] = (char) type;
+	buf[2] = (char) ((type == CREATE || type == UPDATE || type == REPAIR) ? view.replica : PRIMARY);
+	buf[3] = (char) ((type == REPLY || type == READREPLY) && view.success);
+	memcpy(&buf[4], &view.transID, sizeof(int));
+	memcpy(&buf[8], view.fromAddr.addr, sizeof(view.fromAddr.addr));
+	memcpy(&buf[14], &klen, sizeof(klen));
+	memcpy(&buf[16], &vlen, sizeof(vlen));
+	memcpy(&buf[20], &view.timestamp, sizeof(int));
+	memcpy(&buf[MSG_HDRSZ], view.key.data(), klen);
+	memcpy(&buf[MSG_HDRSZ + klen], view.value.data(), vlen);
+	return n;
+}
+
 /**
  * Assignment operator overloading
  */
@@ -169,6 +403,7 @@ Message& Message::operator =(const Message& anotherMessage) {
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
+	this->timestamp = anotherMessage.timestamp;
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
@@ -10,6 +10,30 @@
 #include "Member.h"
 #include "common.h"
 
+/*
+ * Macros
+ */
+// first byte of a binary message, a text message always starts with a digit or '-'
+#define MSG_MAGIC ((char) 0xB7)
+// magic, type, replica, success, transID, fromAddr, key length, value length, timestamp
+#define MSG_HDRSZ 24
+
+/**
+ * STRUCT NAME: MessageView
+ *
+ * DESCRIPTION: A parsed message. key and value point into the buffer it was parsed from.
+ */
+struct MessageView {
+	int transID;
+	Address fromAddr;
+	MessageType type;
+	ReplicaType replica;
+	bool success;
+	int timestamp;
+	string_view key;
+	string_view value;
+};
+
 /**
  * CLASS NAME: Message
  *
@@ -24,10 +48,13 @@ public:
 	Address fromAddr;
 	int transID;
 	bool success; // success or not 
+	int timestamp; // version of the value, the time of the write that made it
 	// delimiter
 	string delimiter;
 	// construct a message from a string
 	Message(string message);
+	Message(const char *data, int size);
+	Message(const MessageView &view);
 	Message(const Message& anotherMessage);
 	// construct a create or update message
 	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value);
@@ -41,6 +68,17 @@ public:
 	Message& operator = (const Message& anotherMessage);
 	// serialize to a string
 	string toString();
+	// serialize into buf, returns the number of bytes written or -1 if it does not fit
+	int encode(char *buf, int size);
+	int encodedSize();
+	// the message as a view of its fields
+	MessageView view();
+	static string toString(const MessageView &view);
+	static int encode(const MessageView &view, char *buf, int size);
+	// parse a binary or text message without allocating
+	static bool parse(const char *data, int size, MessageView *view);
+	// encode in the legacy "::" delimited text format instead of binary
+	static bool textFormat;
 };
 
 #endif
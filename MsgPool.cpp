@@ -0,0 +1,307 @@
+/**********************************
+ * FILE NAME: MsgPool.cpp
+ *
+ * DESCRIPTION: Definition of the message buffer slab allocator
+ **********************************/
+
+#include "MsgPool.h"
+#include "ThreadPool.h"
+
+int MsgPool::currTick = 0;
+vector<msg_cache> MsgPool::caches(1);
+msg_chunk *MsgPool::retired = NULL;
+msg_chunk *MsgPool::spare = NULL;
+mutex MsgPool::spareLock;
+long MsgPool::liveBytes = 0;
+long MsgPool::peakBytes = 0;
+
+/**
+ * FUNCTION NAME: workers
+ *
+ * DESCRIPTION: Sets up one cache per worker of the tick engine. Called before any
+ * 				buffer is allocated.
+ */
+void MsgPool::workers(int n) {
+	caches.resize(max(1, n));
+}
+
+/**
+ * FUNCTION NAME: cache
+ *
+ * DESCRIPTION: Cache of the worker running the current thread
+ */
+msg_cache &MsgPool::cache() {
+	int w = ThreadPool::worker;
+	return caches[(w > 0 && w < (int) caches.size()) ? w : 0];
+}
+
+/**
+ * FUNCTION NAME: classOf
+ *
+ * DESCRIPTION: Returns the smallest size class holding size bytes
+ */
+int MsgPool::classOf(int size) {
+	int cls = 0;
+	while ( cls < MSGPOOL_NCLASS && classSize(cls) < size ) {
+		cls++;
+	}
+	return (cls < MSGPOOL_NCLASS) ? cls : MSGPOOL_OVERSIZE;
+}
+
+/**
+ * FUNCTION NAME: newChunk
+ *
+ * DESCRIPTION: Takes an empty chunk from the spare list or allocates a new one
+ */
+msg_chunk *MsgPool::newChunk(msg_cache &mc) {
+	msg_chunk *c = NULL;
+
+	{
+		lock_guard<mutex> guard(spareLock);
+		if ( spare ) {
+			c = spare;
+			spare = c->next;
+		}
+	}
+	if ( c ) {
+		mc.nrecycled++;
+	}
+	else {
+		c = (msg_chunk *) malloc(sizeof(msg_chunk));
+		mc.nchunks++;
+	}
+	c->tick = currTick;
+	c->live = 0;
+	c->used = 0;
+	c->next = NULL;
+	return c;
+}
+
+/**
+ * FUNCTION NAME: recycle
+ *
+ * DESCRIPTION: Puts an empty chunk back in the spare list, outside of a parallel phase
+ */
+void MsgPool::recycle(msg_chunk *c) {
+	c->next = spare;
+	spare = c;
+}
+
+/**
+ * FUNCTION NAME: alloc
+ *
+ * DESCRIPTION: Returns a buffer of at least size bytes with a reference count of one
+ */
+char *MsgPool::alloc(int size) {
+	msg_cache &mc = cache();
+	msg_buf *b;
+	int cls = classOf(size);
+	size_t bsz;
+
+	if ( cls == MSGPOOL_OVERSIZE ) {
+		b = (msg_buf *) malloc(sizeof(msg_buf) + size);
+		b->cls = MSGPOOL_OVERSIZE;
+		b->capacity = size;
+		b->owner = NULL;
+		mc.allocs[MSGPOOL_NCLASS]++;
+	}
+	else if ( mc.freeList[cls] ) {
+		// reuse a block released by this worker during this tick
+		b = mc.freeList[cls];
+		mc.freeList[cls] = *(msg_buf **)(b + 1);
+		b->owner->live++;
+		mc.allocs[cls]++;
+		mc.hits[cls]++;
+	}
+	else {
+		bsz = sizeof(msg_buf) + classSize(cls);
+		if ( !mc.arena || mc.arena->used + bsz > MSGPOOL_CHUNKSZ ) {
+			msg_chunk *c = newChunk(mc);
+			c->next = mc.arena;
+			mc.arena = c;
+		}
+		b = (msg_buf *)(mc.arena->mem + mc.arena->used);
+		mc.arena->used += bsz;
+		mc.arena->live++;
+		b->cls = cls;
+		b->capacity = classSize(cls);
+		b->owner = mc.arena;
+		mc.allocs[cls]++;
+	}
+	b->refcnt = 1;
+	mc.live += b->capacity;
+	return (char *)(b + 1);
+}
+
+/**
+ * FUNCTION NAME: retain
+ *
+ * DESCRIPTION: Adds a reference to the buffer
+ */
+void MsgPool::retain(void *payload) {
+	if ( payload ) {
+		header(payload)->refcnt++;
+	}
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Drops a reference to the buffer. The last reference gives it back to the pool.
+ */
+void MsgPool::release(void *payload) {
+	msg_cache &mc = cache();
+	msg_buf *b;
+	msg_chunk *c;
+
+	if ( !payload ) {
+		return;
+	}
+	b = header(payload);
+	assert(b->refcnt > 0);
+	if ( --b->refcnt > 0 ) {
+		return;
+	}
+	mc.live -= b->capacity;
+	if ( b->cls == MSGPOOL_OVERSIZE ) {
+		free(b);
+		return;
+	}
+	c = b->owner;
+	c->live--;
+	if ( c->tick == currTick ) {
+		// the free list link lives in the payload
+		*(msg_buf **)(b + 1) = mc.freeList[b->cls];
+		mc.freeList[b->cls] = b;
+	}
+	// a chunk of a past tick is recycled by the next tick once it is empty
+}
+
+/**
+ * FUNCTION NAME: tick
+ *
+ * DESCRIPTION: Starts the arenas of a new time unit. Chunks of the previous one are
+ * 				retired, and retired chunks with nothing alive in them are recycled.
+ */
+void MsgPool::tick(int time) {
+	msg_chunk *c, *next, *keep = NULL;
+
+	if ( time == currTick ) {
+		return;
+	}
+	for ( size_t w = 0; w < caches.size(); w++ ) {
+		for ( c = caches[w].arena; c; c = next ) {
+			next = c->next;
+			c->next = retired;
+			retired = c;
+		}
+		caches[w].arena = NULL;
+		for ( int i = 0; i < MSGPOOL_NCLASS; i++ ) {
+			caches[w].freeList[i] = NULL;
+		}
+	}
+	for ( c = retired; c; c = next ) {
+		next = c->next;
+		if ( c->live == 0 ) {
+			recycle(c);
+		}
+		else {
+			c->next = keep;
+			keep = c;
+		}
+	}
+	retired = keep;
+	currTick = time;
+}
+
+/**
+ * FUNCTION NAME: sample
+ *
+ * DESCRIPTION: Sums the bytes in use at a phase barrier and keeps their peak
+ */
+void MsgPool::sample() {
+	liveBytes = 0;
+	for ( size_t w = 0; w < caches.size(); w++ ) {
+		liveBytes += caches[w].live;
+	}
+	if ( liveBytes > peakBytes ) {
+		peakBytes = liveBytes;
+	}
+}
+
+/**
+ * FUNCTION NAME: printStats
+ *
+ * DESCRIPTION: Writes the statistics that do not depend on the number of workers to file
+ */
+void MsgPool::printStats(FILE *file) {
+	long allocs;
+
+	sample();
+	fprintf(file, "msgpool live_bytes %ld peak_bytes %ld\n", liveBytes, peakBytes);
+	for ( int i = 0; i <= MSGPOOL_NCLASS; i++ ) {
+		allocs = 0;
+		for ( size_t w = 0; w < caches.size(); w++ ) {
+			allocs += caches[w].allocs[i];
+		}
+		if ( i < MSGPOOL_NCLASS ) {
+			fprintf(file, "msgpool class %4d allocs %8ld\n", classSize(i), allocs);
+		}
+		else {
+			fprintf(file, "msgpool oversize allocs %8ld\n", allocs);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: printAllocatorStats
+ *
+ * DESCRIPTION: Writes the chunk and free list counters to file. They depend on how
+ * 				the nodes were dealt to the workers.
+ */
+void MsgPool::printAllocatorStats(FILE *file) {
+	long nchunks = 0, nrecycled = 0, allocs, hits;
+
+	for ( size_t w = 0; w < caches.size(); w++ ) {
+		nchunks += caches[w].nchunks;
+		nrecycled += caches[w].nrecycled;
+	}
+	fprintf(file, "msgpool workers %zu chunks %ld chunk_bytes %ld chunks_recycled %ld\n", caches.size(), nchunks, nchunks * (long) sizeof(msg_chunk), nrecycled);
+	for ( int i = 0; i < MSGPOOL_NCLASS; i++ ) {
+		allocs = hits = 0;
+		for ( size_t w = 0; w < caches.size(); w++ ) {
+			allocs += caches[w].allocs[i];
+			hits += caches[w].hits[i];
+		}
+		fprintf(file, "msgpool class %4d allocs %8ld hits %8ld\n", classSize(i), allocs, hits);
+	}
+}
+
+/**
+ * FUNCTION NAME: drain
+ *
+ * DESCRIPTION: Frees all the chunks held by the pool. Called once at the end of the program.
+ */
+void MsgPool::drain() {
+	msg_chunk *c, *next;
+
+	for ( size_t w = 0; w < caches.size(); w++ ) {
+		for ( c = caches[w].arena; c; c = next ) {
+			next = c->next;
+			free(c);
+		}
+		caches[w].arena = NULL;
+		for ( int i = 0; i < MSGPOOL_NCLASS; i++ ) {
+			caches[w].freeList[i] = NULL;
+		}
+	}
+	for ( c = retired; c; c = next ) {
+		next = c->next;
+		free(c);
+	}
+	for ( c = spare; c; c = next ) {
+		next = c->next;
+		free(c);
+	}
+	retired = spare = NULL;
+}
@@ -0,0 +1,124 @@
+/**********************************
+ * FILE NAME: MsgPool.h
+ *
+ * DESCRIPTION: Slab allocator of reference counted message buffers
+ **********************************/
+
+#ifndef MSGPOOL_H_
+#define MSGPOOL_H_
+
+#include "stdincludes.h"
+#include <mutex>
+#include <atomic>
+
+/*
+ * Macros
+ */
+// size of an arena chunk, blocks are carved from it
+#define MSGPOOL_CHUNKSZ 65536
+// number of size classes, payload sizes 64, 128, ... 4096 bytes
+#define MSGPOOL_NCLASS 7
+#define MSGPOOL_MINCLASS 64
+// class id of buffers too big for any class, they are malloc'ed
+#define MSGPOOL_OVERSIZE -1
+
+struct msg_chunk;
+
+/**
+ * Struct Name: msg_buf
+ *
+ * Header of a pooled message buffer. The payload immediately follows it.
+ */
+typedef struct msg_buf {
+	int refcnt;
+	int cls;
+	int capacity;
+	struct msg_chunk *owner;
+} msg_buf;
+
+/**
+ * Struct Name: msg_chunk
+ *
+ * Arena chunk. Blocks are bump allocated from it by one worker during the tick it
+ * belongs to, the whole chunk is recycled once no block carved from it is referenced.
+ * A block may be released by another worker than the one that carved it, so live
+ * is atomic.
+ */
+typedef struct msg_chunk {
+	int tick;
+	atomic<int> live;
+	size_t used;
+	struct msg_chunk *next;
+	char mem[MSGPOOL_CHUNKSZ];
+} msg_chunk;
+
+/**
+ * Struct Name: msg_cache
+ *
+ * Pool state of one worker of the tick engine: its arena, its free lists and its
+ * counters. live is what the worker allocated minus what it released, the sum over
+ * the workers is the bytes in use.
+ */
+typedef struct msg_cache {
+	msg_chunk *arena;
+	msg_buf *freeList[MSGPOOL_NCLASS];
+	long live;
+	long allocs[MSGPOOL_NCLASS + 1], hits[MSGPOOL_NCLASS + 1];
+	long nchunks, nrecycled;
+} msg_cache;
+
+/**
+ * CLASS NAME: MsgPool
+ *
+ * DESCRIPTION: Hands out reference counted buffers for simulated network messages.
+ * 				A buffer is filled once by the sender, then its ownership moves
+ * 				through EmulNet and the node queues to the message handler, which
+ * 				releases it back to the pool after processing.
+ *
+ * 				Sizes are rounded up to a size class. Every worker of the tick engine
+ * 				carves blocks from an arena of its own for the current tick, and
+ * 				reuses the blocks it releases during that same tick through per class
+ * 				free lists, so alloc, retain and release take no lock. A buffer has
+ * 				one owner at a time, its reference count is not shared. Chunks of past
+ * 				ticks go back to the spare chunks at the next tick once their last
+ * 				block is released; only taking a spare chunk is locked.
+ *
+ * 				The bytes in use are summed at the phase barriers, where they do not
+ * 				depend on the number of workers, and the peak is taken there. The
+ * 				chunk and free list counters do depend on it.
+ */
+class MsgPool {
+private:
+	static int currTick;
+	// one cache per worker, the serial code uses the first one
+	static vector<msg_cache> caches;
+	// chunks of past ticks that still have live blocks
+	static msg_chunk *retired;
+	// empty chunks ready for reuse
+	static msg_chunk *spare;
+	static mutex spareLock;
+	// bytes in use and their peak, taken at the phase barriers
+	static long liveBytes, peakBytes;
+	static msg_cache &cache();
+	static msg_buf *header(void *payload) {
+		return ((msg_buf *)payload) - 1;
+	}
+	static int classOf(int size);
+	static int classSize(int cls) {
+		return MSGPOOL_MINCLASS << cls;
+	}
+	static msg_chunk *newChunk(msg_cache &mc);
+	static void recycle(msg_chunk *c);
+public:
+	static void workers(int n);
+	static char *alloc(int size);
+	static void retain(void *payload);
+	static void release(void *payload);
+	static void tick(int time);
+	static void sample();
+	static void printStats(FILE *file);
+	static void printAllocatorStats(FILE *file);
+	static void drain();
+};
+
+#endif /* MSGPOOL_H_ */
@@ -9,13 +9,23 @@
 /**
  * constructor
  */
-Node::Node() {}
+Node::Node(): nodeHashCode(0), token(0) {}
 
 /**
  * constructor
  */
 Node::Node(Address address) {
 	this->nodeAddress = address;
+	this->token = 0;
+	computeHashCode();
+}
+
+/**
+ * constructor
+ */
+Node::Node(Address address, int token) {
+	this->nodeAddress = address;
+	this->token = token;
 	computeHashCode();
 }
 
@@ -27,10 +37,13 @@ Node::~Node() {}
 /**
  * FUNCTION NAME: computeHashCode
  *
- * DESCRIPTION: This function computes the hash code of the node address
+ * DESCRIPTION: This function computes the hash code of the node address and token,
+ * 				the position of the node on the 64 bit ring
  */
 void Node::computeHashCode() {
-	nodeHashCode = hashFunc(nodeAddress.addr)%RING_SIZE;
+	string id(nodeAddress.addr, sizeof(nodeAddress.addr));
+	id.append((char *) &token, sizeof(token));
+	nodeHashCode = hashFunc(id);
 }
 
 /**
@@ -39,6 +52,7 @@ void Node::computeHashCode() {
 Node::Node(const Node& another) {
 	this->nodeAddress = another.nodeAddress;
 	this->nodeHashCode = another.nodeHashCode;
+	this->token = another.token;
 }
 
 /**
@@ -47,6 +61,7 @@ Node::Node(const Node& another) {
 Node& Node::operator=(const Node& another) {
 	this->nodeAddress = another.nodeAddress;
 	this->nodeHashCode = another.nodeHashCode;
+	this->token = another.token;
 	return *this;
 }
 
@@ -14,9 +14,12 @@ class Node {
 public:
 	Address nodeAddress;
 	size_t nodeHashCode;
+	// virtual node (token) number of this ring position
+	int token;
 	std::hash<string> hashFunc;
 	Node();
 	Node(Address address);
+	Node(Address address, int token);
 	Node(const Node& another);
 	Node& operator=(const Node& another);
 	bool operator < (const Node& another) const;
@@ -19,6 +19,7 @@ Params::Params(): PORTNUM(8001) {}
 void Params::setparams(char *config_file) {
 	//trace.funcEntry("Params::setparams");
 	char CRUD[10];
+	char name[32], value[64];
 	FILE *fp = fopen(config_file,"r");
 
 	fscanf(fp,"MAX_NNB: %d", &MAX_NNB);
@@ -40,6 +41,118 @@ void Params::setparams(char *config_file) {
 		this->CRUDTEST = DELETE_TEST;
 	}
 
+	// Optional settings, one "NAME: value" per line after CRUD_TEST
+	TEXT_MSG = 0;
+	VNODES = 1;
+	PING_FANOUT = 3;
+	THREADS = 1;
+	SEED = time(NULL);
+	strcpy(DATA_DIR, "data");
+	RECOVER = 0;
+	WAL = 0;
+	WAL_SYNC = 1;
+	WAL_GROUP = 1;
+	LSM = 0;
+	MEMTABLE_BYTES = 4 << 20;
+	MEMTABLE_AGE = 0;
+	SST_BLOCK = 4096;
+	BLOOM_BITS = 10;
+	COMPACT_RUNS = 4;
+	COMPACT_RATE = 8 << 20;
+	COMPACT_THREADS = 0;
+	TOMBSTONE_TTL = 20;
+	HINTS = 1;
+	HINT_MEMORY = 1 << 20;
+	HINT_BATCH = 64;
+	READ_QUORUM = 2;
+	WRITE_QUORUM = 2;
+	HEDGED_READS = 0;
+	HEDGE_AFTER = 0.67;
+	while ( fscanf(fp, " %31[^:\n]: %63s", name, value) == 2 ) {
+		if ( 0 == strcmp(name, "TEXT_MSG") ) {
+			TEXT_MSG = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "VNODES") ) {
+			VNODES = max(1, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "PING_FANOUT") ) {
+			PING_FANOUT = max(0, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "THREADS") ) {
+			THREADS = max(1, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "SEED") ) {
+			SEED = strtoul(value, NULL, 10);
+		}
+		else if ( 0 == strcmp(name, "DATA_DIR") ) {
+			strcpy(DATA_DIR, value);
+		}
+		else if ( 0 == strcmp(name, "RECOVER") ) {
+			RECOVER = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WAL") ) {
+			WAL = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WAL_SYNC") ) {
+			WAL_SYNC = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WAL_GROUP") ) {
+			WAL_GROUP = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "LSM") ) {
+			LSM = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "MEMTABLE_BYTES") ) {
+			MEMTABLE_BYTES = max(1L, atol(value));
+		}
+		else if ( 0 == strcmp(name, "MEMTABLE_AGE") ) {
+			MEMTABLE_AGE = max(0, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "SST_BLOCK") ) {
+			SST_BLOCK = max(64, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "BLOOM_BITS") ) {
+			BLOOM_BITS = max(0, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "COMPACT_RUNS") ) {
+			COMPACT_RUNS = max(0, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "COMPACT_RATE") ) {
+			COMPACT_RATE = max(0L, atol(value));
+		}
+		else if ( 0 == strcmp(name, "COMPACT_THREADS") ) {
+			COMPACT_THREADS = max(0, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "TOMBSTONE_TTL") ) {
+			TOMBSTONE_TTL = max(0, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "HINTS") ) {
+			HINTS = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "HINT_MEMORY") ) {
+			HINT_MEMORY = max(0L, atol(value));
+		}
+		else if ( 0 == strcmp(name, "HINT_BATCH") ) {
+			HINT_BATCH = max(1, atoi(value));
+		}
+		else if ( 0 == strcmp(name, "READ_QUORUM") ) {
+			READ_QUORUM = min(3, max(1, atoi(value)));
+		}
+		else if ( 0 == strcmp(name, "WRITE_QUORUM") ) {
+			WRITE_QUORUM = min(3, max(1, atoi(value)));
+		}
+		else if ( 0 == strcmp(name, "HEDGED_READS") ) {
+			HEDGED_READS = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "HEDGE_AFTER") ) {
+			HEDGE_AFTER = max(0.0, atof(value));
+		}
+	}
+	// a read must meet the last write among the three replicas of a key
+	if ( READ_QUORUM + WRITE_QUORUM <= 3 ) {
+		READ_QUORUM = 4 - WRITE_QUORUM;
+	}
+
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
 	EN_GPSZ = MAX_NNB;
@@ -65,3 +178,12 @@ void Params::setparams(char *config_file) {
 int Params::getcurrtime(){
     return globaltime;
 }
+
+/**
+ * FUNCTION NAME: rng
+ *
+ * DESCRIPTION: Returns the random generator of a node for a stream
+ */
+Random Params::rng(int node, RandomStream stream) {
+	return Random(SEED, node, stream);
+}
@@ -10,6 +10,7 @@
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "Random.h"
 
 enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
 
@@ -32,9 +33,36 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	int TEXT_MSG;               // send KV store messages in the legacy text format
+	int VNODES;                 // ring tokens (virtual nodes) per member
+	int PING_FANOUT;            // peers pinged per time unit, 3 by default, 0 pings all of them
+	int THREADS;                // worker threads of the tick engine
+	unsigned long SEED;         // seed of every random generator, the start time if not set
+	char DATA_DIR[64];          // directory of the node files
+	int RECOVER;                // reopen the node files left in DATA_DIR, 0 removes them at start
+	int WAL;                    // log replica writes to a per node write-ahead log
+	int WAL_SYNC;               // fdatasync the log on every commit
+	int WAL_GROUP;              // one commit per message queue drain, 0 commits every write
+	int LSM;                    // flush the memtable to sorted table files
+	long MEMTABLE_BYTES;        // memtable size that triggers a flush
+	int MEMTABLE_AGE;           // time units after its first write that trigger a flush, 0 never
+	int SST_BLOCK;              // data block size of the table files
+	int BLOOM_BITS;             // Bloom filter bits per key of the table files, 0 for none
+	int COMPACT_RUNS;           // runs of similar size merged together, 0 never merges
+	long COMPACT_RATE;          // bytes per second written by the merges of all the nodes, 0 unlimited
+	int COMPACT_THREADS;        // threads merging the runs of all the nodes, 0 for THREADS
+	int TOMBSTONE_TTL;          // time units a delete is kept: replicas forget it after, merges drop it
+	int HINTS;                  // keep the writes to suspected replicas and hand them off later
+	long HINT_MEMORY;           // bytes of hints held in memory by a node before they spill to disk
+	int HINT_BATCH;             // hints delivered to a replica per time unit
+	int READ_QUORUM;            // replies that answer a read
+	int WRITE_QUORUM;           // successes that answer a create, update or delete
+	int HEDGED_READS;           // read from READ_QUORUM replicas, not all of them, and hedge
+	double HEDGE_AFTER;         // fraction of the timeout before a hedged read asks one more replica
 	Params();
 	void setparams(char *);
 	int getcurrtime();
+	Random rng(int node, RandomStream stream);
 };
 
 #endif /* _PARAMS_H_ */
@@ -20,8 +20,7 @@ public:
 	Queue() {}
 	virtual ~Queue() {}
 	static bool enqueue(queue<q_elt> *queue, void *buffer, int size) {
-		q_elt element(buffer, size);
-		queue->emplace(element);
+		queue->emplace(buffer, size);
 		return true;
 	}
 };
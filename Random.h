@@ -0,0 +1,72 @@
+/**********************************
+ * FILE NAME: Random.h
+ *
+ * DESCRIPTION: Seeded pseudo random generator of the simulator
+ **********************************/
+
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+
+/*
+ * Streams of the simulator, each node gets its own generator per stream
+ */
+enum RandomStream { RNG_APP, RNG_NET_MP1, RNG_NET_MP2, RNG_PING };
+
+/**
+ * CLASS NAME: Random
+ *
+ * DESCRIPTION: xoshiro256** generator. The state is expanded from the run seed, the
+ * 				node id and the stream with splitmix64, so every node and subsystem
+ * 				draws from an independent sequence that only depends on the seed.
+ * 				Meets UniformRandomBitGenerator, so it can be used with shuffle.
+ */
+class Random {
+private:
+	uint64_t s[4];
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+	static uint64_t splitmix(uint64_t &x) {
+		uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+public:
+	typedef uint64_t result_type;
+	Random(uint64_t seed = 0, int node = 0, int stream = 0) {
+		uint64_t x = seed;
+		x = splitmix(x) ^ (uint64_t) node;
+		x = splitmix(x) ^ (uint64_t) stream;
+		for ( int i = 0; i < 4; i++ ) {
+			s[i] = splitmix(x);
+		}
+	}
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT64_MAX; }
+	result_type operator()() {
+		uint64_t r = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return r;
+	}
+
+	/**
+	 * FUNCTION NAME: below
+	 *
+	 * DESCRIPTION: Returns a number in [0, n), n > 0
+	 */
+	int below(int n) {
+		return (int) (((*this)() >> 32) * (uint64_t) n >> 32);
+	}
+};
+
+#endif /* RANDOM_H_ */
@@ -0,0 +1,206 @@
+/**********************************
+ * FILE NAME: Ring.cpp
+ *
+ * DESCRIPTION: Ring class definition
+ **********************************/
+
+#include "Ring.h"
+
+/**
+ * FUNCTION NAME: build
+ *
+ * DESCRIPTION: Builds the ring out of the given members, vnodes tokens per member
+ */
+void Ring::build(vector<Node> &members, int vnodes) {
+	if ( vnodes < 1 ) {
+		vnodes = 1;
+	}
+	nmembers = (int) members.size();
+	nodes.clear();
+	nodes.reserve(members.size() * vnodes);
+	for ( size_t i = 0; i < members.size(); i++ ) {
+		for ( int t = 0; t < vnodes; t++ ) {
+			nodes.emplace_back(members[i].nodeAddress, t);
+		}
+	}
+	sort(nodes.begin(), nodes.end());
+	hashes.resize(nodes.size());
+	for ( size_t i = 0; i < nodes.size(); i++ ) {
+		hashes[i] = nodes[i].getHashCode();
+	}
+}
+
+/**
+ * FUNCTION NAME: contains
+ *
+ * DESCRIPTION: Tells whether addr is a member of the ring, looking up its first token
+ */
+bool Ring::contains(Address &addr) {
+	Node first(addr, 0);
+	vector<size_t>::iterator it = lower_bound(hashes.begin(), hashes.end(), first.getHashCode());
+	for ( ; it != hashes.end() && *it == first.getHashCode(); it++ ) {
+		if ( nodes[it - hashes.begin()].nodeAddress == addr ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: insert
+ *
+ * DESCRIPTION: Adds the vnodes tokens of a new member at their sorted positions
+ *
+ * RETURNS:
+ * false if addr was already in the ring
+ */
+bool Ring::insert(Address &addr, int vnodes) {
+	size_t i;
+
+	if ( contains(addr) ) {
+		return false;
+	}
+	if ( vnodes < 1 ) {
+		vnodes = 1;
+	}
+	for ( int t = 0; t < vnodes; t++ ) {
+		Node token(addr, t);
+		i = upper_bound(hashes.begin(), hashes.end(), token.getHashCode()) - hashes.begin();
+		hashes.insert(hashes.begin() + i, token.getHashCode());
+		nodes.insert(nodes.begin() + i, token);
+	}
+	nmembers++;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: remove
+ *
+ * DESCRIPTION: Removes all the tokens of a member
+ *
+ * RETURNS:
+ * false if addr was not in the ring
+ */
+bool Ring::remove(Address &addr) {
+	size_t i, j;
+
+	for ( i = j = 0; i < nodes.size(); i++ ) {
+		if ( nodes[i].nodeAddress == addr ) {
+			continue;
+		}
+		if ( i != j ) {
+			nodes[j] = nodes[i];
+			hashes[j] = hashes[i];
+		}
+		j++;
+	}
+	if ( j == nodes.size() ) {
+		return false;
+	}
+	nodes.resize(j);
+	hashes.resize(j);
+	nmembers--;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Removes all the members
+ */
+void Ring::clear() {
+	nodes.clear();
+	hashes.clear();
+	nmembers = 0;
+}
+
+/**
+ * FUNCTION NAME: successor
+ *
+ * DESCRIPTION: Index of the first node at or after pos, wrapping around the ring
+ *
+ * RETURNS:
+ * ring index, -1 if the ring is empty
+ */
+int Ring::successor(size_t pos) {
+	if ( hashes.empty() ) {
+		return -1;
+	}
+	vector<size_t>::iterator it = lower_bound(hashes.begin(), hashes.end(), pos);
+	if ( it == hashes.end() ) {
+		return 0;
+	}
+	return (int) (it - hashes.begin());
+}
+
+/**
+ * FUNCTION NAME: findReplicas
+ *
+ * DESCRIPTION: Ring indexes of the nodes holding the key at position pos. Walks the
+ * 				ring clockwise from the successor of pos, skipping the tokens of
+ * 				members that were already picked.
+ *
+ * RETURNS:
+ * false if the ring is too small to hold all the replicas
+ */
+bool Ring::findReplicas(size_t pos, ReplicaSet &replicas) {
+	int n = size(), found = 0, idx, j;
+	if ( nmembers < RING_REPLICAS ) {
+		return false;
+	}
+	idx = successor(pos);
+	for ( int i = 0; i < n && found < RING_REPLICAS; i++, idx = (idx + 1) % n ) {
+		for ( j = 0; j < found; j++ ) {
+			if ( nodes[replicas[j]].nodeAddress == nodes[idx].nodeAddress ) {
+				break;
+			}
+		}
+		if ( j == found ) {
+			replicas[found++] = idx;
+		}
+	}
+	return found == RING_REPLICAS;
+}
+
+/**
+ * FUNCTION NAME: isReplica
+ *
+ * DESCRIPTION: Tells whether addr holds a replica of the key at position pos
+ */
+bool Ring::isReplica(size_t pos, Address &addr) {
+	ReplicaSet replicas;
+	if ( !findReplicas(pos, replicas) ) {
+		return false;
+	}
+	for ( int i = 0; i < RING_REPLICAS; i++ ) {
+		if ( nodes[replicas[i]].nodeAddress == addr ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: share
+ *
+ * DESCRIPTION: Fraction of the ring space for which addr is the primary replica
+ */
+double Ring::share(Address &addr) {
+	double owned = 0;
+	size_t prev;
+
+	if ( nodes.empty() ) {
+		return 0;
+	}
+	if ( nmembers == 1 ) {
+		return (nodes[0].nodeAddress == addr) ? 1 : 0;
+	}
+	for ( size_t i = 0; i < nodes.size(); i++ ) {
+		if ( nodes[i].nodeAddress == addr ) {
+			// the arc (previous token, this token], wrapping around at the first one
+			prev = hashes[(i + nodes.size() - 1) % nodes.size()];
+			owned += (double) (hashes[i] - prev);
+		}
+	}
+	return owned / RING_SPACE;
+}
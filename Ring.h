@@ -0,0 +1,56 @@
+/**********************************
+ * FILE NAME: Ring.h
+ *
+ * DESCRIPTION: Header file Ring class
+ **********************************/
+
+#ifndef RING_H_
+#define RING_H_
+
+#include "stdincludes.h"
+#include <array>
+#include "Member.h"
+#include "Node.h"
+
+/*
+ * Macros
+ */
+// number of replicas of every key
+#define RING_REPLICAS 3
+
+// ring indexes of the replicas of a key, primary first
+typedef array<int, RING_REPLICAS> ReplicaSet;
+// size of the 64 bit ring space, as a double
+#define RING_SPACE 18446744073709551616.0
+
+/**
+ * CLASS NAME: Ring
+ *
+ * DESCRIPTION: Consistent hashing ring over the 64 bit hash space. Every member is
+ * 				placed at several points (tokens, or virtual nodes). Tokens are kept
+ * 				sorted by hash code next to a flat array of their hash codes, so the
+ * 				successor of a key is found with a binary search.
+ */
+class Ring {
+private:
+	vector<Node> nodes;
+	vector<size_t> hashes;
+	// number of physical members
+	int nmembers;
+public:
+	Ring(): nmembers(0) {}
+	void build(vector<Node> &members, int vnodes);
+	bool contains(Address &addr);
+	bool insert(Address &addr, int vnodes);
+	bool remove(Address &addr);
+	void clear();
+	int size() { return (int) nodes.size(); }
+	int members() { return nmembers; }
+	Node &at(int i) { return nodes.at(i); }
+	int successor(size_t pos);
+	bool findReplicas(size_t pos, ReplicaSet &replicas);
+	bool isReplica(size_t pos, Address &addr);
+	double share(Address &addr);
+};
+
+#endif /* RING_H_ */
@@ -0,0 +1,380 @@
+/**********************************
+ * FILE NAME: SSTable.cpp
+ *
+ * DESCRIPTION: Definition of the SSTable reader and builder
+ **********************************/
+
+#include "SSTable.h"
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Constructor. Maps the file and parses its filter and index in place; the table is
+ * not open if the file is missing or its footer, filter or index are corrupt. scan
+ * tells the kernel to read ahead for a pass over the whole table, otherwise to
+ * expect point lookups.
+ */
+SSTable::SSTable(const char *path, long firstSeq, long lastSeq, bool scan): map(NULL), path(path), firstSeq(firstSeq), lastSeq(lastSeq), nrecords(0), fileBytes(0), blockReads(0), filterSkips(0), falsePositives(0) {
+	const char *footer, *index, *bloom;
+	uint64_t indexOff, filterOff;
+	uint32_t indexSize, indexCrc, filterSize, filterCrc, magic, klen;
+	struct stat st;
+	size_t pos;
+	sst_block blk;
+	void *m;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if ( fd < 0 ) {
+		return;
+	}
+	if ( fstat(fd, &st) != 0 || st.st_size < SST_FOOTER ) {
+		close(fd);
+		goto corrupt;
+	}
+	m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// the mapping keeps the file
+	close(fd);
+	if ( m == MAP_FAILED ) {
+		perror(path);
+		return;
+	}
+	map = (const char *) m;
+	fileBytes = st.st_size;
+	madvise(m, fileBytes, scan ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+	footer = map + fileBytes - SST_FOOTER;
+	memcpy(&indexOff, footer, 8);
+	memcpy(&indexSize, footer + 8, 4);
+	memcpy(&indexCrc, footer + 12, 4);
+	memcpy(&filterSize, footer + 16, 4);
+	memcpy(&filterCrc, footer + 20, 4);
+	memcpy(&nrecords, footer + 24, 4);
+	memcpy(&magic, footer + 28, 4);
+	if ( magic != SST_MAGIC || indexOff + indexSize + SST_FOOTER != fileBytes || filterSize > indexOff ) {
+		goto corrupt;
+	}
+	filterOff = indexOff - filterSize;
+	// filter and index are read at once, whatever the advice
+	pos = filterOff & ~(uint64_t) (sysconf(_SC_PAGESIZE) - 1);
+	madvise((void *) (map + pos), fileBytes - pos, MADV_WILLNEED);
+	bloom = map + filterOff;
+	if ( crc32(bloom, filterSize) != filterCrc ) {
+		goto corrupt;
+	}
+	// probed in place when the builder aligned it, copied otherwise
+	if ( !filter.attach(bloom, filterSize) && !filter.load(bloom, filterSize) ) {
+		goto corrupt;
+	}
+	index = map + indexOff;
+	if ( crc32(index, indexSize) != indexCrc ) {
+		goto corrupt;
+	}
+	for ( pos = 0; pos + 4 <= indexSize; pos += 4 + klen + 16 ) {
+		memcpy(&klen, index + pos, 4);
+		if ( pos + 4 + klen + 16 > indexSize ) {
+			goto corrupt;
+		}
+		firstKeys.emplace_back(index + pos + 4, klen);
+		memcpy(&blk.off, index + pos + 4 + klen, 8);
+		memcpy(&blk.size, index + pos + 4 + klen + 8, 4);
+		memcpy(&blk.crc, index + pos + 4 + klen + 12, 4);
+		if ( blk.off + blk.size > filterOff ) {
+			goto corrupt;
+		}
+		blocks.push_back(blk);
+	}
+	checked.assign(blocks.size(), 0);
+	return;
+
+corrupt:
+	fprintf(stderr, "%s: corrupt table\n", path);
+	if ( map ) {
+		munmap((void *) map, fileBytes);
+		map = NULL;
+	}
+	firstKeys.clear();
+	blocks.clear();
+}
+
+/**
+ * Destructor
+ */
+SSTable::~SSTable() {
+	if ( map ) {
+		munmap((void *) map, fileBytes);
+	}
+}
+
+/**
+ * FUNCTION NAME: block
+ *
+ * DESCRIPTION: Sets data to data block b, in the mapping. Its CRC is checked the
+ * 				first time it is used.
+ *
+ * RETURNS:
+ * false if the block is corrupt
+ */
+bool SSTable::block(size_t b, string_view &data) {
+	blockReads++;
+	data = string_view(map + blocks[b].off, blocks[b].size);
+	if ( checked[b] == 0 ) {
+		checked[b] = (crc32(data.data(), data.size()) == blocks[b].crc) ? 1 : -1;
+		if ( checked[b] < 0 ) {
+			fprintf(stderr, "%s: corrupt block %zu\n", path.c_str(), b);
+		}
+	}
+	return checked[b] > 0;
+}
+
+/**
+ * FUNCTION NAME: get
+ *
+ * DESCRIPTION: Looks key up, hash being BloomFilter::hashOf(key). value is set to the
+ * 				stored value, type byte included, in the mapping: it stays valid as
+ * 				long as the table is open.
+ *
+ * RETURNS:
+ * SST_FOUND or SST_ABSENT
+ */
+int SSTable::get(string_view key, uint64_t hash, string_view &value) {
+	string_view data;
+	size_t b, pos;
+	uint32_t klen, vlen;
+
+	if ( !map || blocks.empty() ) {
+		return SST_ABSENT;
+	}
+	if ( !filter.mayContain(hash) ) {
+		filterSkips++;
+		return SST_ABSENT;
+	}
+	// last block whose first key is not greater than key
+	b = upper_bound(firstKeys.begin(), firstKeys.end(), key) - firstKeys.begin();
+	if ( b == 0 || !block(b - 1, data) ) {
+		falsePositives += (b == 0 && !filter.empty());
+		return SST_ABSENT;
+	}
+	for ( pos = 0; pos + SST_RECORD_HEADER <= data.size(); pos += SST_RECORD_HEADER + klen + vlen ) {
+		memcpy(&klen, data.data() + pos, 4);
+		memcpy(&vlen, data.data() + pos + 4, 4);
+		string_view k = data.substr(pos + SST_RECORD_HEADER, klen);
+		if ( k == key ) {
+			value = data.substr(pos + SST_RECORD_HEADER + klen, vlen);
+			return SST_FOUND;
+		}
+		if ( k > key ) {
+			break;
+		}
+	}
+	falsePositives += !filter.empty();
+	return SST_ABSENT;
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the heap bytes held for this table, the mapping aside
+ */
+unsigned long SSTable::memoryBytes() {
+	return blocks.capacity() * sizeof(sst_block) + firstKeys.capacity() * sizeof(string_view)
+			+ checked.capacity() + filter.heapBytes();
+}
+
+/**
+ * Constructor, positioned on the first record
+ */
+SSTableIterator::SSTableIterator(SSTable *table): table(table), b(0), pos(0), valid(false), corrupt(false) {
+	parse();
+}
+
+/**
+ * FUNCTION NAME: parse
+ *
+ * DESCRIPTION: Reads the record at pos, moving to the next blocks at the end of one.
+ * 				A corrupt block is skipped and marks the iterator corrupt.
+ */
+void SSTableIterator::parse() {
+	uint32_t klen, vlen;
+
+	valid = false;
+	for ( ; b < table->blocks.size(); b++, pos = 0 ) {
+		if ( pos == 0 && !table->block(b, data) ) {
+			corrupt = true;
+			continue;
+		}
+		if ( pos + SST_RECORD_HEADER > data.size() ) {
+			continue;
+		}
+		memcpy(&klen, data.data() + pos, 4);
+		memcpy(&vlen, data.data() + pos + 4, 4);
+		k = data.substr(pos + SST_RECORD_HEADER, klen);
+		v = data.substr(pos + SST_RECORD_HEADER + klen, vlen);
+		valid = true;
+		return;
+	}
+}
+
+/**
+ * FUNCTION NAME: next
+ *
+ * DESCRIPTION: Moves to the next record
+ */
+void SSTableIterator::next() {
+	if ( valid ) {
+		pos += SST_RECORD_HEADER + k.size() + v.size();
+		parse();
+	}
+}
+
+/**
+ * Constructor. The table is built in path.tmp.
+ */
+SSTableBuilder::SSTableBuilder(const char *path, size_t blockSize, int bitsPerKey): path(path), blockSize(blockSize), bitsPerKey(bitsPerKey), off(0), nrecords(0), failed(false) {
+	string tmp = this->path + ".tmp";
+	fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	failed = (fd < 0);
+}
+
+/**
+ * Destructor. An unfinished table is removed.
+ */
+SSTableBuilder::~SSTableBuilder() {
+	if ( fd >= 0 ) {
+		close(fd);
+		unlink((path + ".tmp").c_str());
+	}
+}
+
+/**
+ * FUNCTION NAME: emit
+ *
+ * DESCRIPTION: Appends bytes to the file
+ */
+void SSTableBuilder::emit(const char *data, size_t size) {
+	ssize_t n;
+
+	while ( !failed && size > 0 ) {
+		n = write(fd, data, size);
+		if ( n < 0 ) {
+			failed = (errno != EINTR);
+			continue;
+		}
+		data += n;
+		size -= n;
+		off += n;
+	}
+}
+
+/**
+ * FUNCTION NAME: flushBlock
+ *
+ * DESCRIPTION: Writes the current data block and adds its index entry
+ */
+void SSTableBuilder::flushBlock() {
+	uint32_t klen = firstKey.size(), size = block.size(), crc;
+	uint64_t at = off;
+	size_t pos = index.size();
+
+	if ( block.empty() ) {
+		return;
+	}
+	crc = crc32(block.data(), block.size());
+	emit(block.data(), block.size());
+	index.resize(pos + 4 + klen + 16);
+	memcpy(&index[pos], &klen, 4);
+	memcpy(&index[pos + 4], firstKey.data(), klen);
+	memcpy(&index[pos + 4 + klen], &at, 8);
+	memcpy(&index[pos + 4 + klen + 8], &size, 4);
+	memcpy(&index[pos + 4 + klen + 12], &crc, 4);
+	block.clear();
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Appends a record. Keys must come in increasing order.
+ */
+void SSTableBuilder::add(string_view key, string_view value) {
+	uint32_t klen = key.size(), vlen = value.size();
+	size_t pos = block.size();
+
+	if ( block.empty() ) {
+		firstKey.assign(key);
+	}
+	block.resize(pos + SST_RECORD_HEADER + klen + vlen);
+	memcpy(&block[pos], &klen, 4);
+	memcpy(&block[pos + 4], &vlen, 4);
+	memcpy(&block[pos + SST_RECORD_HEADER], key.data(), klen);
+	memcpy(&block[pos + SST_RECORD_HEADER + klen], value.data(), vlen);
+	if ( bitsPerKey > 0 ) {
+		hashes.push_back(BloomFilter::hashOf(key));
+	}
+	nrecords++;
+	if ( block.size() >= blockSize ) {
+		flushBlock();
+	}
+}
+
+/**
+ * FUNCTION NAME: finish
+ *
+ * DESCRIPTION: Writes the filter, the index and the footer, then makes the table durable
+ * 				and visible
+ *
+ * RETURNS:
+ * true if the table was written
+ */
+bool SSTableBuilder::finish() {
+	char footer[SST_FOOTER];
+	uint64_t indexOff;
+	uint32_t indexSize, indexCrc, filterSize, filterCrc, magic = SST_MAGIC;
+	string tmp = path + ".tmp", dir;
+	BloomFilter filter(hashes.size(), bitsPerKey);
+	int dirfd;
+
+	flushBlock();
+	for ( size_t i = 0; i < hashes.size(); i++ ) {
+		filter.add(hashes[i]);
+	}
+	// align the filter so readers can probe it in the mapping
+	if ( off % BLOOM_ALIGN != 0 ) {
+		char pad[BLOOM_ALIGN] = { 0 };
+		emit(pad, BLOOM_ALIGN - off % BLOOM_ALIGN);
+	}
+	filterSize = filter.bytes();
+	filterCrc = crc32(filter.data(), filterSize);
+	emit(filter.data(), filterSize);
+	indexOff = off;
+	indexSize = index.size();
+	indexCrc = crc32(index.data(), index.size());
+	emit(index.data(), index.size());
+	memcpy(footer, &indexOff, 8);
+	memcpy(footer + 8, &indexSize, 4);
+	memcpy(footer + 12, &indexCrc, 4);
+	memcpy(footer + 16, &filterSize, 4);
+	memcpy(footer + 20, &filterCrc, 4);
+	memcpy(footer + 24, &nrecords, 4);
+	memcpy(footer + 28, &magic, 4);
+	emit(footer, SST_FOOTER);
+	if ( !failed && fdatasync(fd) != 0 ) {
+		failed = true;
+	}
+	if ( close(fd) != 0 ) {
+		failed = true;
+	}
+	fd = -1;
+	if ( failed || rename(tmp.c_str(), path.c_str()) != 0 ) {
+		unlink(tmp.c_str());
+		return false;
+	}
+	// make the rename durable
+	dir = path.substr(0, path.find_last_of('/') == string::npos ? 0 : path.find_last_of('/'));
+	dirfd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+	if ( dirfd >= 0 ) {
+		fsync(dirfd);
+		close(dirfd);
+	}
+	return true;
+}
@@ -0,0 +1,175 @@
+/**********************************
+ * FILE NAME: SSTable.h
+ *
+ * DESCRIPTION: Immutable sorted string table files of the LSM store
+ **********************************/
+
+#ifndef SSTABLE_H_
+#define SSTABLE_H_
+
+#include "stdincludes.h"
+#include "Crc32.h"
+#include "BloomFilter.h"
+#include <stdint.h>
+#include <string_view>
+
+/*
+ * Macros
+ */
+// record types, first byte of every stored value
+#define SST_VALUE 'V'
+#define SST_TOMBSTONE 'T'
+// get results
+#define SST_ABSENT 0
+#define SST_FOUND 1
+// record header: key length, value length
+#define SST_RECORD_HEADER 8
+// footer: index offset, index size, index crc, filter size, filter crc, record count, magic
+#define SST_FOOTER 32
+#define SST_MAGIC 0x53535443
+
+/**
+ * STRUCT NAME: sst_block
+ *
+ * DESCRIPTION: Sparse index entry, one per data block
+ */
+typedef struct sst_block {
+	uint64_t off;
+	uint32_t size;
+	uint32_t crc;
+} sst_block;
+
+/**
+ * CLASS NAME: SSTable
+ *
+ * DESCRIPTION: Reader of a table file. The file is a run of data blocks holding the
+ * 				records sorted by key, then the Bloom filter of the keys, aligned to
+ * 				a cache line, then an index block with the first key, the position
+ * 				and the CRC-32 of every data block, then a fixed size footer.
+ *
+ * 				The file is mapped read-only and used in place: the filter is probed
+ * 				in the mapping, the index keys point into it and lookups return
+ * 				values from it, with no read calls or copies. A lookup probes the
+ * 				filter, binary searches the index and touches a single data block.
+ *
+ * 				Record: key length, value length, key, value. The first byte of the
+ * 				value is its type, SST_VALUE or SST_TOMBSTONE.
+ */
+class SSTable {
+private:
+	const char *map;
+	string path;
+	// flushes covered, a merged table covers those of its inputs
+	long firstSeq, lastSeq;
+	uint32_t nrecords;
+	uint64_t fileBytes;
+	vector<string_view> firstKeys;
+	vector<sst_block> blocks;
+	// CRC of the block checked: 0 not yet, 1 good, -1 corrupt
+	vector<signed char> checked;
+	BloomFilter filter;
+	// statistics
+	long blockReads, filterSkips, falsePositives;
+	bool block(size_t b, string_view &data);
+	friend class SSTableIterator;
+public:
+	SSTable(const char *path, long firstSeq, long lastSeq, bool scan = false);
+	SSTable(const SSTable &) = delete;
+	SSTable &operator=(const SSTable &) = delete;
+	virtual ~SSTable();
+	bool isOpen() { return map != NULL; }
+	long getFirstSeq() { return firstSeq; }
+	long getLastSeq() { return lastSeq; }
+	const string &getPath() { return path; }
+	uint32_t records() { return nrecords; }
+	uint64_t bytes() { return fileBytes; }
+	long getBlockReads() { return blockReads; }
+	long getFilterSkips() { return filterSkips; }
+	long getFalsePositives() { return falsePositives; }
+	unsigned long memoryBytes();
+	int get(string_view key, uint64_t hash, string_view &value);
+
+	/**
+	 * FUNCTION NAME: forEach
+	 *
+	 * DESCRIPTION: Calls f(key, value) for every record in key order. The views are
+	 * 				valid as long as the table is open.
+	 */
+	template <class F>
+	void forEach(F f) {
+		string_view data;
+		uint32_t klen, vlen;
+		for ( size_t b = 0; b < blocks.size(); b++ ) {
+			if ( !block(b, data) ) {
+				continue;
+			}
+			for ( size_t pos = 0; pos + SST_RECORD_HEADER <= data.size(); pos += SST_RECORD_HEADER + klen + vlen ) {
+				memcpy(&klen, data.data() + pos, 4);
+				memcpy(&vlen, data.data() + pos + 4, 4);
+				f(data.substr(pos + SST_RECORD_HEADER, klen), data.substr(pos + SST_RECORD_HEADER + klen, vlen));
+			}
+		}
+	}
+};
+
+/**
+ * CLASS NAME: SSTableIterator
+ *
+ * DESCRIPTION: Walks the records of a table in key order. key and value are valid
+ * 				as long as the table is open.
+ */
+class SSTableIterator {
+private:
+	SSTable *table;
+	// current block and record
+	size_t b;
+	string_view data;
+	size_t pos;
+	string_view k, v;
+	bool valid;
+	// a block failed its checksum, its records were skipped
+	bool corrupt;
+	void parse();
+public:
+	SSTableIterator(SSTable *table);
+	bool isValid() { return valid; }
+	bool isCorrupt() { return corrupt; }
+	string_view key() { return k; }
+	string_view value() { return v; }
+	void next();
+};
+
+/**
+ * CLASS NAME: SSTableBuilder
+ *
+ * DESCRIPTION: Writes a table file from records added in key order. Data blocks are
+ * 				written as they fill up. finish writes the filter, with bitsPerKey bits
+ * 				per key (0 for none), the index and the footer, syncs the file and
+ * 				renames it from path.tmp to path, so a table is either complete or
+ * 				absent after a crash.
+ */
+class SSTableBuilder {
+private:
+	int fd;
+	string path;
+	size_t blockSize;
+	int bitsPerKey;
+	uint64_t off;
+	uint32_t nrecords;
+	vector<char> block;
+	string firstKey;
+	vector<char> index;
+	// key hashes for the filter
+	vector<uint64_t> hashes;
+	bool failed;
+	void emit(const char *data, size_t size);
+	void flushBlock();
+public:
+	SSTableBuilder(const char *path, size_t blockSize, int bitsPerKey);
+	virtual ~SSTableBuilder();
+	void add(string_view key, string_view value);
+	bool finish();
+	uint64_t bytes() { return off; }
+};
+
+#endif /* SSTABLE_H_ */
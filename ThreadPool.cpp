@@ -0,0 +1,154 @@
+/**********************************
+ * FILE NAME: ThreadPool.cpp
+ *
+ * DESCRIPTION: Definition of the work stealing thread pool
+ **********************************/
+
+#include "ThreadPool.h"
+
+/*
+ * Macros
+ */
+// ranges dealt to every worker per phase
+#define RANGES_PER_WORKER 4
+
+thread_local int ThreadPool::worker = -1;
+thread_local int ThreadPool::taskKey = -1;
+
+/**
+ * Constructor
+ */
+ThreadPool::ThreadPool(int nthreads) {
+	this->nthreads = max(1, nthreads);
+	this->generation = 0;
+	this->stop = false;
+	this->pending = 0;
+	this->order = NULL;
+	ranges.resize(this->nthreads);
+	for ( int i = 0; i < this->nthreads; i++ ) {
+		rangeLocks.emplace_back(new mutex());
+	}
+	for ( int i = 1; i < this->nthreads; i++ ) {
+		threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+/**
+ * Destructor
+ */
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> g(lock);
+		stop = true;
+	}
+	wake.notify_all();
+	for ( size_t i = 0; i < threads.size(); i++ ) {
+		threads[i].join();
+	}
+}
+
+/**
+ * FUNCTION NAME: workerLoop
+ *
+ * DESCRIPTION: Body of the pool threads, runs ranges every time a phase starts
+ */
+void ThreadPool::workerLoop(int id) {
+	long seen = 0;
+
+	while ( true ) {
+		{
+			unique_lock<mutex> g(lock);
+			wake.wait(g, [&] { return stop || generation != seen; });
+			if ( stop ) {
+				return;
+			}
+			seen = generation;
+		}
+		runRanges(id);
+	}
+}
+
+/**
+ * FUNCTION NAME: nextRange
+ *
+ * DESCRIPTION: Takes a range from the front of the worker's deque, or steals one
+ * 				from the back of another worker's deque
+ */
+bool ThreadPool::nextRange(int id, range &r) {
+	for ( int k = 0; k < nthreads; k++ ) {
+		int victim = (id + k) % nthreads;
+		lock_guard<mutex> g(*rangeLocks[victim]);
+		if ( ranges[victim].empty() ) {
+			continue;
+		}
+		if ( k == 0 ) {
+			r = ranges[victim].front();
+			ranges[victim].pop_front();
+		}
+		else {
+			r = ranges[victim].back();
+			ranges[victim].pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: runRanges
+ *
+ * DESCRIPTION: Runs ranges until there are none left
+ */
+void ThreadPool::runRanges(int id) {
+	range r;
+
+	worker = id;
+	while ( nextRange(id, r) ) {
+		for ( int i = r.begin; i < r.end; i++ ) {
+			taskKey = i;
+			job((*order)[i]);
+		}
+		if ( pending.fetch_sub(1) == 1 ) {
+			lock_guard<mutex> g(lock);
+			done.notify_all();
+		}
+	}
+	worker = -1;
+	taskKey = -1;
+}
+
+/**
+ * FUNCTION NAME: parallelFor
+ *
+ * DESCRIPTION: Calls job(order[i]) for every i, the nodes of the phase are given
+ * 				in the order the sequential simulator would run them
+ */
+void ThreadPool::parallelFor(const vector<int> &order, function<void(int)> job) {
+	int n = order.size();
+	int nranges, size, w = 0;
+
+	if ( n == 0 ) {
+		return;
+	}
+	size = max(1, n / (nthreads * RANGES_PER_WORKER));
+	nranges = (n + size - 1) / size;
+	this->order = &order;
+	this->job = job;
+	pending = nranges;
+	for ( int b = 0; b < n; b += size, w = (w + 1) % nthreads ) {
+		range r = { b, min(n, b + size) };
+		lock_guard<mutex> g(*rangeLocks[w]);
+		ranges[w].push_back(r);
+	}
+	if ( nthreads > 1 ) {
+		lock_guard<mutex> g(lock);
+		generation++;
+		wake.notify_all();
+	}
+	runRanges(0);
+	{
+		unique_lock<mutex> g(lock);
+		done.wait(g, [&] { return pending.load() == 0; });
+	}
+	this->order = NULL;
+}
@@ -0,0 +1,82 @@
+/**********************************
+ * FILE NAME: ThreadPool.h
+ *
+ * DESCRIPTION: Work stealing thread pool of the tick engine
+ **********************************/
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include "stdincludes.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
+/**
+ * CLASS NAME: ThreadPool
+ *
+ * DESCRIPTION: Runs one phase of a tick over a set of nodes. The nodes are split
+ * 				in ranges dealt to per worker deques; a worker runs its own ranges
+ * 				from the front and steals from the back of the others when it runs
+ * 				out. The calling thread is worker 0 and parallelFor returns once
+ * 				every range is done, which is the barrier between phases.
+ *
+ * 				While a node runs, worker and taskKey tell which worker runs it and
+ * 				its position in the sequential order of the phase. EmulNet and Log
+ * 				use them to buffer sends and log lines per worker, to be merged in
+ * 				taskKey order at the barrier, so the outcome does not depend on the
+ * 				number of threads.
+ */
+class ThreadPool {
+private:
+	struct range {
+		int begin;
+		int end;
+	};
+	int nthreads;
+	vector<thread> threads;
+	vector< deque<range> > ranges;
+	vector< unique_ptr<mutex> > rangeLocks;
+	mutex lock;
+	condition_variable wake, done;
+	// bumped for every phase, workers wait for it to change
+	long generation;
+	bool stop;
+	atomic<int> pending;
+	const vector<int> *order;
+	function<void(int)> job;
+	void workerLoop(int id);
+	bool nextRange(int id, range &r);
+	void runRanges(int id);
+public:
+	// worker running the current thread, -1 outside of parallelFor
+	static thread_local int worker;
+	// position of the node being run in the sequential order of the phase
+	static thread_local int taskKey;
+	ThreadPool(int nthreads);
+	virtual ~ThreadPool();
+	int size() { return nthreads; }
+	void parallelFor(const vector<int> &order, function<void(int)> job);
+
+	/**
+	 * FUNCTION NAME: merge
+	 *
+	 * DESCRIPTION: Moves the per worker buffers into out, ordered by their seq field.
+	 * 				Entries of the same task keep their order.
+	 */
+	template <class T>
+	static void merge(vector< vector<T> > &buffers, vector<T> &out) {
+		out.clear();
+		for ( size_t w = 0; w < buffers.size(); w++ ) {
+			out.insert(out.end(), buffers[w].begin(), buffers[w].end());
+			buffers[w].clear();
+		}
+		stable_sort(out.begin(), out.end(), [](const T &a, const T &b) { return a.seq < b.seq; });
+	}
+};
+
+#endif /* THREADPOOL_H_ */
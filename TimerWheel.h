@@ -0,0 +1,124 @@
+/**********************************
+ * FILE NAME: TimerWheel.h
+ *
+ * DESCRIPTION: Hierarchical timer wheel
+ **********************************/
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// bits of time covered by one level, 64 slots per level
+#define TWHEEL_BITS 6
+#define TWHEEL_SLOTS (1 << TWHEEL_BITS)
+// number of levels, 64^3 time units before timers need re-hashing
+#define TWHEEL_LEVELS 3
+
+/**
+ * CLASS NAME: TimerWheel
+ *
+ * DESCRIPTION: Timers are hashed by deadline into levels of 64 slots. Slots of
+ * 				level 0 are one time unit wide, slots of level k are 64^k units wide.
+ * 				When the clock enters a slot of an upper level its timers cascade
+ * 				to the level below, so advancing the clock visits one level 0 slot
+ * 				per elapsed time unit plus the occasional cascade. Timers are never
+ * 				cancelled, the owner checks on expiry whether the timer is still
+ * 				relevant.
+ */
+template <class T>
+class TimerWheel {
+private:
+	struct timer {
+		T id;
+		int deadline;
+	};
+	vector<timer> slots[TWHEEL_LEVELS][TWHEEL_SLOTS];
+	vector<timer> due;
+	// last time unit already processed
+	int now;
+
+	/**
+	 * FUNCTION NAME: place
+	 *
+	 * DESCRIPTION: Puts a timer in the lowest level whose span, seen from time unit
+	 * 				base (not processed yet), contains its deadline
+	 */
+	void place(const timer &t, int base) {
+		int d = max(t.deadline, base);
+		int k;
+		for ( k = 0; k < TWHEEL_LEVELS - 1; k++ ) {
+			if ( (d >> (TWHEEL_BITS * (k + 1))) == (base >> (TWHEEL_BITS * (k + 1))) ) {
+				break;
+			}
+		}
+		slots[k][(d >> (TWHEEL_BITS * k)) & (TWHEEL_SLOTS - 1)].push_back(t);
+	}
+
+	/**
+	 * FUNCTION NAME: tick
+	 *
+	 * DESCRIPTION: Processes time unit t, moving its timers to the due list
+	 */
+	void tick(int t) {
+		vector<timer> moved;
+		// cascade the upper level slots that start at t, highest first
+		for ( int k = TWHEEL_LEVELS - 1; k > 0; k-- ) {
+			if ( (t & ((1 << (TWHEEL_BITS * k)) - 1)) == 0 ) {
+				moved.swap(slots[k][(t >> (TWHEEL_BITS * k)) & (TWHEEL_SLOTS - 1)]);
+				for ( size_t i = 0; i < moved.size(); i++ ) {
+					place(moved[i], t);
+				}
+				moved.clear();
+			}
+		}
+		vector<timer> &slot = slots[0][t & (TWHEEL_SLOTS - 1)];
+		size_t j = 0;
+		for ( size_t i = 0; i < slot.size(); i++ ) {
+			if ( slot[i].deadline <= t ) {
+				due.push_back(slot[i]);
+			}
+			else {
+				slot[j++] = slot[i];
+			}
+		}
+		slot.resize(j);
+	}
+public:
+	TimerWheel(int now = 0) {
+		this->now = now;
+	}
+
+	/**
+	 * FUNCTION NAME: schedule
+	 *
+	 * DESCRIPTION: Fires id once the clock reaches deadline
+	 */
+	void schedule(T id, int deadline) {
+		timer t = { id, deadline };
+		place(t, now + 1);
+	}
+
+	/**
+	 * FUNCTION NAME: advance
+	 *
+	 * DESCRIPTION: Moves the clock to time and calls expire(id) for every timer
+	 * 				that became due, in deadline order
+	 */
+	template <class F>
+	void advance(int time, F expire) {
+		while ( now < time ) {
+			tick(++now);
+		}
+		// expire may schedule new timers, so the due list is walked on its own
+		for ( size_t i = 0; i < due.size(); i++ ) {
+			expire(due[i].id);
+		}
+		due.clear();
+	}
+};
+
+#endif /* TIMERWHEEL_H_ */
@@ -0,0 +1,123 @@
+/**********************************
+ * FILE NAME: TransTable.h
+ *
+ * DESCRIPTION: Open addressing table of pending transactions
+ **********************************/
+
+#ifndef TRANSTABLE_H_
+#define TRANSTABLE_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// initial number of slots, always a power of two
+#define TRANSTABLE_MINSZ 64
+// key of a free slot, transaction ids are never negative
+#define TRANS_EMPTY -1
+
+/**
+ * CLASS NAME: TransTable
+ *
+ * DESCRIPTION: Table of pending requests keyed by transaction id. Linear probing
+ * 				over a power of two array of slots, erased slots are filled back by
+ * 				shifting the following entries of the probe sequence, so lookups
+ * 				never walk over tombstones. Grows when it is 3/4 full.
+ */
+template <class T>
+class TransTable {
+private:
+	vector<int> keys;
+	vector<T> vals;
+	size_t count;
+	size_t mask;
+	size_t home(int key) {
+		// Fibonacci hashing, spreads the consecutive ids of a coordinator
+		return (size_t) (((unsigned long long) key * 11400714819323198485ull) >> 40) & mask;
+	}
+	void grow() {
+		vector<int> oldKeys;
+		vector<T> oldVals;
+		oldKeys.swap(keys);
+		oldVals.swap(vals);
+		keys.assign(oldKeys.size() * 2, TRANS_EMPTY);
+		vals.resize(oldKeys.size() * 2);
+		mask = keys.size() - 1;
+		count = 0;
+		for ( size_t i = 0; i < oldKeys.size(); i++ ) {
+			if ( oldKeys[i] != TRANS_EMPTY ) {
+				insert(oldKeys[i], oldVals[i]);
+			}
+		}
+	}
+public:
+	TransTable(): keys(TRANSTABLE_MINSZ, TRANS_EMPTY), vals(TRANSTABLE_MINSZ), count(0), mask(TRANSTABLE_MINSZ - 1) {}
+	size_t size() { return count; }
+
+	/**
+	 * FUNCTION NAME: find
+	 *
+	 * DESCRIPTION: Returns the request with the given id, NULL if there is none
+	 */
+	T *find(int key) {
+		if ( key < 0 ) {
+			return NULL;
+		}
+		for ( size_t i = home(key); keys[i] != TRANS_EMPTY; i = (i + 1) & mask ) {
+			if ( keys[i] == key ) {
+				return &vals[i];
+			}
+		}
+		return NULL;
+	}
+
+	/**
+	 * FUNCTION NAME: insert
+	 *
+	 * DESCRIPTION: Adds a request, or replaces the one with the same id
+	 */
+	T *insert(int key, const T &val) {
+		size_t i;
+		assert(key >= 0);
+		if ( (count + 1) * 4 > keys.size() * 3 ) {
+			grow();
+		}
+		for ( i = home(key); keys[i] != TRANS_EMPTY && keys[i] != key; i = (i + 1) & mask );
+		if ( keys[i] == TRANS_EMPTY ) {
+			keys[i] = key;
+			count++;
+		}
+		vals[i] = val;
+		return &vals[i];
+	}
+
+	/**
+	 * FUNCTION NAME: erase
+	 *
+	 * DESCRIPTION: Removes the request with the given id
+	 */
+	bool erase(int key) {
+		size_t i, j, h;
+		T *p = find(key);
+		if ( !p ) {
+			return false;
+		}
+		i = p - &vals[0];
+		// shift back the entries that probed past slot i
+		for ( j = (i + 1) & mask; keys[j] != TRANS_EMPTY; j = (j + 1) & mask ) {
+			h = home(keys[j]);
+			if ( ((j - h) & mask) >= ((j - i) & mask) ) {
+				keys[i] = keys[j];
+				vals[i] = vals[j];
+				i = j;
+			}
+		}
+		keys[i] = TRANS_EMPTY;
+		vals[i] = T();
+		count--;
+		return true;
+	}
+};
+
+#endif /* TRANSTABLE_H_ */
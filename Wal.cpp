@@ -0,0 +1,197 @@
+/**********************************
+ * FILE NAME: Wal.cpp
+ *
+ * DESCRIPTION: Definition of the write-ahead log
+ **********************************/
+
+#include "Wal.h"
+#include <errno.h>
+
+/**
+ * Constructor. Opens or creates the log file, records are appended after the
+ * existing ones.
+ */
+Wal::Wal(const char *path, bool sync): sync(sync), path(path), records(0), commits(0), bytes(0) {
+	fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+}
+
+/**
+ * Destructor
+ */
+Wal::~Wal() {
+	if ( fd >= 0 ) {
+		commit();
+		close(fd);
+	}
+}
+
+/**
+ * FUNCTION NAME: append
+ *
+ * DESCRIPTION: Adds a record to the current group. It is on disk after the next commit.
+ */
+void Wal::append(WalOp op, string_view key, string_view value) {
+	uint32_t len = WAL_PAYLOAD_HEADER + key.size() + value.size();
+	uint32_t klen = key.size(), vlen = value.size(), crc;
+	size_t at = group.size();
+	char *p;
+
+	group.resize(at + WAL_HEADER + len);
+	p = &group[at];
+	memcpy(p, &len, 4);
+	p[WAL_HEADER] = (char) op;
+	memcpy(p + WAL_HEADER + 1, &klen, 4);
+	memcpy(p + WAL_HEADER + 5, &vlen, 4);
+	memcpy(p + WAL_HEADER + WAL_PAYLOAD_HEADER, key.data(), klen);
+	memcpy(p + WAL_HEADER + WAL_PAYLOAD_HEADER + klen, value.data(), vlen);
+	crc = crc32(p + WAL_HEADER, len);
+	memcpy(p + 4, &crc, 4);
+	records++;
+}
+
+/**
+ * FUNCTION NAME: commit
+ *
+ * DESCRIPTION: Writes the current group with one write call, then flushes it to disk.
+ * 				A group that cannot be written whole is cut from the file, so the
+ * 				groups committed after it are not hidden behind a torn record.
+ *
+ * RETURNS:
+ * true if the group is durable, or there was nothing to write
+ */
+bool Wal::commit() {
+	size_t done = 0;
+	ssize_t n;
+	off_t start;
+
+	if ( group.empty() ) {
+		return true;
+	}
+	if ( fd < 0 ) {
+		group.clear();
+		return false;
+	}
+	// O_APPEND writes at the end, where the group starts
+	start = lseek(fd, 0, SEEK_END);
+	while ( done < group.size() ) {
+		n = write(fd, &group[done], group.size() - done);
+		if ( n < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			if ( done > 0 && (start < 0 || ftruncate(fd, start) != 0) ) {
+				// what follows would be lost on replay, later commits fail instead
+				perror(path.c_str());
+				close(fd);
+				fd = -1;
+			}
+			group.clear();
+			return false;
+		}
+		done += n;
+	}
+	bytes += group.size();
+	group.clear();
+	commits++;
+	return !sync || fdatasync(fd) == 0;
+}
+
+/**
+ * FUNCTION NAME: replay
+ *
+ * DESCRIPTION: Calls apply for every valid record in the file, in order. The file is
+ * 				cut after the last valid record, so a write torn by a crash is dropped.
+ *
+ * RETURNS:
+ * number of records replayed
+ */
+long Wal::replay(function<void(WalOp, string_view, string_view)> apply) {
+	vector<char> data;
+	char buf[65536];
+	ssize_t n;
+	size_t pos = 0;
+	uint32_t len, crc, klen, vlen;
+	long count = 0;
+
+	if ( fd < 0 ) {
+		return 0;
+	}
+	lseek(fd, 0, SEEK_SET);
+	while ( (n = read(fd, buf, sizeof(buf))) > 0 ) {
+		data.insert(data.end(), buf, buf + n);
+	}
+	while ( pos + WAL_HEADER + WAL_PAYLOAD_HEADER <= data.size() ) {
+		const char *p = &data[pos];
+		memcpy(&len, p, 4);
+		memcpy(&crc, p + 4, 4);
+		if ( len < WAL_PAYLOAD_HEADER || pos + WAL_HEADER + len > data.size() || crc32(p + WAL_HEADER, len) != crc ) {
+			break;
+		}
+		memcpy(&klen, p + WAL_HEADER + 1, 4);
+		memcpy(&vlen, p + WAL_HEADER + 5, 4);
+		if ( (uint64_t) WAL_PAYLOAD_HEADER + klen + vlen != len ) {
+			break;
+		}
+		apply((WalOp) p[WAL_HEADER], string_view(p + WAL_HEADER + WAL_PAYLOAD_HEADER, klen),
+				string_view(p + WAL_HEADER + WAL_PAYLOAD_HEADER + klen, vlen));
+		pos += WAL_HEADER + len;
+		count++;
+	}
+	if ( pos < data.size() && ftruncate(fd, pos) != 0 ) {
+		perror(path.c_str());
+	}
+	return count;
+}
+
+/**
+ * FUNCTION NAME: readAt
+ *
+ * DESCRIPTION: Calls apply for up to max committed records, starting at byte offset
+ * 				pos, and moves pos past them. Unlike replay it reads only what it
+ * 				returns and leaves the file as it is, so a log can be consumed a few
+ * 				records at a time.
+ *
+ * RETURNS:
+ * number of records read, 0 at the end of the log or at a corrupt record
+ */
+long Wal::readAt(uint64_t &pos, long max, function<void(WalOp, string_view, string_view)> apply) {
+	char head[WAL_HEADER];
+	vector<char> payload;
+	uint32_t len, crc, klen, vlen;
+	long count = 0;
+
+	if ( fd < 0 ) {
+		return 0;
+	}
+	while ( count < max && pread(fd, head, WAL_HEADER, pos) == WAL_HEADER ) {
+		memcpy(&len, head, 4);
+		memcpy(&crc, head + 4, 4);
+		if ( len < WAL_PAYLOAD_HEADER ) {
+			break;
+		}
+		payload.resize(len);
+		if ( pread(fd, &payload[0], len, pos + WAL_HEADER) != (ssize_t) len || crc32(&payload[0], len) != crc ) {
+			break;
+		}
+		memcpy(&klen, &payload[1], 4);
+		memcpy(&vlen, &payload[5], 4);
+		if ( (uint64_t) WAL_PAYLOAD_HEADER + klen + vlen != len ) {
+			break;
+		}
+		apply((WalOp) payload[0], string_view(&payload[WAL_PAYLOAD_HEADER], klen),
+				string_view(&payload[WAL_PAYLOAD_HEADER + klen], vlen));
+		pos += WAL_HEADER + len;
+		count++;
+	}
+	return count;
+}
+
+/**
+ * FUNCTION NAME: reset
+ *
+ * DESCRIPTION: Empties the log, once its records are stored elsewhere
+ */
+bool Wal::reset() {
+	group.clear();
+	return fd >= 0 && ftruncate(fd, 0) == 0;
+}
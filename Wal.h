@@ -0,0 +1,59 @@
+/**********************************
+ * FILE NAME: Wal.h
+ *
+ * DESCRIPTION: Write-ahead log of the replica writes of a node
+ **********************************/
+
+#ifndef WAL_H_
+#define WAL_H_
+
+#include "stdincludes.h"
+#include "Crc32.h"
+#include <stdint.h>
+#include <string_view>
+#include <functional>
+
+/*
+ * Macros
+ */
+// record framing: payload length and crc, both 32 bits
+#define WAL_HEADER 8
+// payload: op, key length, value length, key, value
+#define WAL_PAYLOAD_HEADER 9
+
+enum WalOp { WAL_PUT = 1, WAL_DEL = 2 };
+
+/**
+ * CLASS NAME: Wal
+ *
+ * DESCRIPTION: Append-only log file. Records are buffered by append and written by
+ * 				commit with a single write, followed by fdatasync when sync is set, so
+ * 				every write handled in one drain of the message queue shares one
+ * 				disk flush (group commit). Each record carries the CRC-32 of its
+ * 				payload; replay stops at the first torn or corrupt record and cuts
+ * 				the file there.
+ */
+class Wal {
+private:
+	int fd;
+	bool sync;
+	string path;
+	// records of the group being built
+	vector<char> group;
+	// statistics
+	long records, commits, bytes;
+public:
+	Wal(const char *path, bool sync);
+	virtual ~Wal();
+	bool isOpen() { return fd >= 0; }
+	void append(WalOp op, string_view key, string_view value);
+	bool commit();
+	long replay(function<void(WalOp, string_view, string_view)> apply);
+	long readAt(uint64_t &pos, long max, function<void(WalOp, string_view, string_view)> apply);
+	bool reset();
+	long getRecords() { return records; }
+	long getCommits() { return commits; }
+	long getBytes() { return bytes; }
+};
+
+#endif /* WAL_H_ */
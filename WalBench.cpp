@@ -0,0 +1,75 @@
+/**********************************
+ * FILE NAME: WalBench.cpp
+ *
+ * DESCRIPTION: Durable write throughput of the write-ahead log, one commit per
+ * 				write against group commit
+ *
+ * RUN PROCEDURE:
+ * $ make walbench
+ * $ ./walbench [writes] [dir]
+ **********************************/
+
+#include "Wal.h"
+#include <sys/stat.h>
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Appends writes records of a test sized pair to a fresh log in dir,
+ * 				with a commit and an fdatasync every group records
+ *
+ * RETURNS:
+ * writes per second, -1 if the log cannot be written
+ */
+static double run(const char *dir, int writes, int group) {
+	char path[256], key[16], value[16];
+	struct timespec start, end;
+	bool ok = true;
+
+	snprintf(path, sizeof(path), "%s/walbench-%d.wal", dir, group);
+	unlink(path);
+	Wal wal(path, true);
+	if ( !wal.isOpen() ) {
+		perror(path);
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for ( int i = 0; i < writes && ok; i++ ) {
+		snprintf(key, sizeof(key), "key%d", i);
+		snprintf(value, sizeof(value), "value%d", i);
+		wal.append(WAL_PUT, key, value);
+		if ( (i + 1) % group == 0 || i == writes - 1 ) {
+			ok = wal.commit();
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	unlink(path);
+	if ( !ok ) {
+		perror(path);
+		return -1;
+	}
+	return writes / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: Prints the throughput of each group size
+ */
+int main(int argc, char *argv[]) {
+	static const int groups[] = { 1, 10, 100 };
+	int writes = (argc > 1) ? atoi(argv[1]) : 3000;
+	const char *dir = (argc > 2) ? argv[2] : "data";
+	double rate;
+
+	mkdir(dir, 0755);
+	printf("%d durable writes to %s\n", writes, dir);
+	for ( int i = 0; i < 3; i++ ) {
+		rate = run(dir, writes, groups[i]);
+		if ( rate < 0 ) {
+			return 1;
+		}
+		printf("%4d writes per commit: %10.0f writes/s\n", groups[i], rate);
+	}
+	return 0;
+}
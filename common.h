@@ -1,14 +1,10 @@
 #ifndef COMMON_H_
 #define COMMON_H_
 
-/**
- * Global variable
- */
-// Transaction Id
-static int g_transID = 0;
-
 // message types, reply is the message from node to coordinator
-enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY};
+// repair carries the newest version of a key to a replica that returned an older one
+// batch carries the records of several keys for one replica, batchreply their outcomes
+enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY, REPAIR, BATCH, BATCHREPLY};
 // enum of replica types
 enum ReplicaType {PRIMARY, SECONDARY, TERTIARY};
 